@@ -0,0 +1,43 @@
+--
+--  hebitmap.lua
+--  HEBitmap
+--
+--  Created by Matteo D'Ignazio on 19/10/26.
+--
+
+-- Lua helpers for the C bindings (he_lua.c)
+-- The C API can't read Lua tables: arrays are packed into a string with a single string.pack call
+
+local pack <const> = string.pack
+local rep <const> = string.rep
+local unpack <const> = table.unpack
+
+local formats = {}
+
+-- Packs an array of numbers as native floats
+function hebitmap.pack(values)
+	local count = #values
+	local format = formats[count]
+	if format == nil then
+		format = "=" .. rep("f", count)
+		formats[count] = format
+	end
+	return pack(format, unpack(values, 1, count))
+end
+
+local function packed(values)
+	if type(values) == "table" then
+		return hebitmap.pack(values)
+	end
+	return values
+end
+
+-- Draws the bitmap at each position, xs and ys can be arrays or packed strings
+function hebitmap.bitmap:drawMany(xs, ys)
+	self:drawPacked(packed(xs), packed(ys))
+end
+
+-- Draws a frame (or an array of frames) at each position
+function hebitmap.table:drawMany(frames, xs, ys)
+	self:drawPacked(packed(frames), packed(xs), packed(ys))
+end
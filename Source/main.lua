@@ -0,0 +1,60 @@
+--
+--  main.lua
+--  HEBitmap
+--
+--  Created by Matteo D'Ignazio on 19/10/26.
+--
+
+-- Lua example, build with LUA_EXAMPLE defined
+
+import "hebitmap"
+
+local gfx <const> = playdate.graphics
+
+local ENTITY_COUNT <const> = 300
+local VELOCITY <const> = 20
+
+local bitmap = hebitmap.bitmap.load("dvd")
+local width, height = bitmap:getSize()
+
+local xs = {}
+local ys = {}
+local dirXs = {}
+local dirYs = {}
+
+for i = 1, ENTITY_COUNT do
+	xs[i] = math.random(0, 400 - width)
+	ys[i] = math.random(0, 240 - height)
+	dirXs[i] = math.random(0, 1) == 0 and -1 or 1
+	dirYs[i] = math.random(0, 1) == 0 and -1 or 1
+end
+
+playdate.display.setRefreshRate(0)
+playdate.resetElapsedTime()
+
+function playdate.update()
+	local dt = playdate.getElapsedTime()
+	playdate.resetElapsedTime()
+
+	gfx.clear(gfx.kColorWhite)
+
+	for i = 1, ENTITY_COUNT do
+		local x = xs[i] + dirXs[i] * VELOCITY * dt
+		local y = ys[i] + dirYs[i] * VELOCITY * dt
+
+		if x < 0 or x > (400 - width) then
+			dirXs[i] = -dirXs[i]
+		end
+		if y < 0 or y > (240 - height) then
+			dirYs[i] = -dirYs[i]
+		end
+
+		xs[i] = x
+		ys[i] = y
+	end
+
+	-- One Lua to C call for all the entities
+	bitmap:drawMany(xs, ys)
+
+	playdate.drawFPS(0, 0)
+end
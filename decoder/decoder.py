@@ -18,6 +18,16 @@ if os.path.isabs(input_arg):
 filename = os.path.splitext(os.path.basename(input_file))[0]
 extension = os.path.splitext(input_file)[1]
 
+frame_reference = 0x80000000
+frame_delta = 0x40000000
+frame_size_mask = 0x3FFFFFFF
+
+fill_none = 0
+fill_white = 2
+
+compression_lz = 2
+lz_min_match = 4
+
 def read_u8(data, offset):
     value = int.from_bytes(data[offset[0]:(offset[0]+1)], byteorder="big", signed=False)
     offset[0] += 1
@@ -47,6 +57,41 @@ def decompress(data, offset, length):
             i += 1
     return result
 
+def lz_length(data, offset, length):
+    if length == 15:
+        value = 255
+        while value == 255:
+            value = read_u8(data, offset)
+            length += value
+    return length
+
+def lz_decompress(data, offset, length, dictionary):
+    # Version 9: the window is the dictionary followed by the output
+    result = bytearray()
+    while len(result) < length:
+        token = read_u8(data, offset)
+        literals = lz_length(data, offset, token >> 4)
+        result.extend(data[offset[0]:(offset[0]+literals)])
+        offset[0] += literals
+        if len(result) >= length:
+            break
+        match_offset = read_u8(data, offset) << 8
+        match_offset |= read_u8(data, offset)
+        match_len = lz_length(data, offset, token & 0x0F) + lz_min_match
+        for _ in range(match_len):
+            position = len(result) - match_offset
+            result.append(result[position] if position >= 0 else dictionary[len(dictionary) + position])
+    return result[:length]
+
+def read_plane(data, offset, length, compression, dictionary):
+    if compression == compression_lz:
+        return lz_decompress(data, offset, length, dictionary)
+    elif compression:
+        return bytearray(decompress(data, offset, length))
+    plane = bytearray(data[offset[0]:(offset[0]+length)])
+    offset[0] += length
+    return plane
+
 def unpack_bits(data):
     result = []
     for byte in data:
@@ -54,7 +99,7 @@ def unpack_bits(data):
             result.append((byte >> i) & 1)
     return result
 
-def decode_heb(data):
+def decode_heb(data, dictionary=b""):
     offset = [0]
 
     version = read_u32(data, offset)
@@ -68,10 +113,17 @@ def decode_heb(data):
     rowbytes = read_u32(data, offset)
     has_mask = read_bool(data, offset)
     
-    compressed = False
+    compression = 0
     if version >= 3:
         # Version 3 supports compression
-        compressed = read_bool(data, offset)
+        compression = read_u8(data, offset)
+
+    fill = fill_none
+    if version >= 7:
+        # Version 7 supports fill
+        fill = read_u8(data, offset)
+        if not has_mask:
+            fill = fill_none
 
     if version >= 2:
         # Version 2 supports padding
@@ -83,16 +135,22 @@ def decode_heb(data):
     image_data = None
     mask_data = None
     
-    if compressed:
-        image_data = unpack_bits(decompress(data, offset, data_size))
-        if has_mask:
-            mask_data = unpack_bits(decompress(data, offset, data_size))
+    if fill != fill_none:
+        # Mask only, visible pixels have the fill color
+        mask_data = read_plane(data, offset, data_size, compression, dictionary)
+        image_data = bytearray(mask_data if fill == fill_white else data_size)
     else:
-        image_data = unpack_bits(data[offset[0]:(offset[0]+data_size)])
-        offset[0] += data_size
+        image_data = read_plane(data, offset, data_size, compression, dictionary)
         if has_mask:
-            mask_data = unpack_bits(data[offset[0]:(offset[0]+data_size)])
-            offset[0] += data_size
+            mask_data = read_plane(data, offset, data_size, compression, dictionary)
+
+    return decode_planes(width, height, bx, by, bw, bh, rowbytes, image_data, mask_data)
+
+def decode_planes(width, height, bx, by, bw, bh, rowbytes, plane_data, plane_mask):
+    image_data = unpack_bits(plane_data)
+    mask_data = None
+    if plane_mask is not None:
+        mask_data = unpack_bits(plane_mask)
 
     img = Image.new("RGBA", (width, height))
     for y1 in range(bh):
@@ -107,35 +165,72 @@ def decode_heb(data):
 
     return {
         "bounds": [bx, by, bw, bh],
-        "img": img
+        "img": img,
+        "planes": (width, height, bx, by, bw, bh, rowbytes, plane_data, plane_mask)
     }
 
+def decode_delta(data, previous):
+    # Version 6: changed word runs from the previous frame
+    width, height, bx, by, bw, bh, rowbytes, plane_data, plane_mask = previous["planes"]
+    plane_data = bytearray(plane_data)
+
+    offset = [0]
+    runs_count = read_u32(data, offset)
+    for _ in range(runs_count):
+        run_offset = read_u32(data, offset)
+        run_len = read_u32(data, offset)
+        plane_data[run_offset:(run_offset+run_len)] = data[offset[0]:(offset[0]+run_len)]
+        offset[0] += run_len
+
+    return decode_planes(width, height, bx, by, bw, bh, rowbytes, plane_data, plane_mask)
+
 def decode_hebt(data):
     offset = [0]
 
     version = read_u32(data, offset)
     length = read_u32(data, offset)
 
-    compressed = False
+    compression = 0
+    dictionary_size = 0
     if version >= 3:
         # Version 3 supports compression
-        compressed = read_bool(data, offset)
+        compression = read_u8(data, offset)
 
-        if version >= 4 and compressed:
+        if version >= 4 and compression:
             # Allocator length
             read_u32(data, offset)
-        
+
+        if version >= 9 and compression == compression_lz:
+            # Version 9 supports dictionary, the compressed length is not needed
+            dictionary_size = read_u32(data, offset)
+            read_u32(data, offset)
+
     if version >= 2:
         # Version 2 supports padding
         padding_len = read_u32(data, offset)
         offset[0] += padding_len
-    
+
+    if version >= 8:
+        # Version 8 supports frame index, frames are read in order
+        offset[0] += length * 8
+
+    # Version 9: the dictionary follows the index
+    dictionary = lz_decompress(data, offset, dictionary_size, b"")
+
     bitmaps = []
     for _ in range(length):
         bitmap_size = read_u32(data, offset)
 
-        info = decode_heb(data[offset[0]:(offset[0]+bitmap_size)])
-        offset[0] += bitmap_size
+        if bitmap_size & frame_reference:
+            # Version 5: reference to a previous frame
+            info = bitmaps[bitmap_size & frame_size_mask]
+        elif bitmap_size & frame_delta:
+            bitmap_size &= frame_size_mask
+            info = decode_delta(data[offset[0]:(offset[0]+bitmap_size)], bitmaps[-1])
+            offset[0] += bitmap_size
+        else:
+            info = decode_heb(data[offset[0]:(offset[0]+bitmap_size)], dictionary)
+            offset[0] += bitmap_size
         bitmaps.append(info)
 
     return {
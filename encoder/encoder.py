@@ -1,24 +1,37 @@
 import os
 import argparse
+import hashlib
+import json
+import multiprocessing
 from PIL import Image
 from PIL import ImageSequence
 import re
 
-format_version = 4
+format_version = 9
 
-# arguments
+frame_reference = 0x80000000
+frame_delta = 0x40000000
 
-parser = argparse.ArgumentParser(description="HEBitmap Encoder")
-parser.add_argument('-i', "--input", help="input file. You can pass in a file or a folder containing a Playdate image table (name-table-1.png, name-table-2.png, ...). Compression is enabled by default.", required=True)
-parser.add_argument('-r', "--raw", help="Save the file as raw data (no compression).", required=False, action='store_true')
+fill_none = 0
+fill_black = 1
+fill_white = 2
 
-args = parser.parse_args()
+compression_none = 0
+compression_rle = 1
+compression_lz = 2
 
-input_arg = args.input
-compressed = not args.raw
+# LZ sequences (version 9): the window is the dictionary followed by the output
+lz_min_match = 4
+lz_window = 65535
+lz_chain_depth = 16
+lz_dictionary_max = 32768
 
-working_dir = os.getcwd()
-output_dir = working_dir
+# unchanged words merged into a delta run (a run header is 8 bytes)
+delta_max_gap = 2
+
+cache_filename = ".hebcache"
+
+image_extensions = (".png", ".gif")
 
 def set_bit(byte, value, position):
     if value == 1:
@@ -69,7 +82,137 @@ def compress(data, rowbytes, bh):
 
     return output
 
-def encode_image(im):
+def lz_length(output, length):
+    # Extended length, continues while the byte is 255
+    while length >= 255:
+        output.append(255)
+        length -= 255
+    output.append(length)
+
+def lz_sequence(output, literals, offset, match_len):
+    token = min(len(literals), 15) << 4
+    if match_len > 0:
+        token |= min(match_len - lz_min_match, 15)
+    output.append(token)
+    if len(literals) >= 15:
+        lz_length(output, len(literals) - 15)
+    output.extend(literals)
+    if match_len > 0:
+        output.extend(offset.to_bytes(2, byteorder="big"))
+        if match_len - lz_min_match >= 15:
+            lz_length(output, match_len - lz_min_match - 15)
+
+def lz_insert(buf, position, head, prev):
+    key = buf[position:position + lz_min_match]
+    prev[position] = head.get(key, -1)
+    head[key] = position
+
+def lz_chains(dictionary):
+    # Hash chains of the dictionary, shared by all the planes of a table
+    head = {}
+    prev = [-1] * len(dictionary)
+    for position in range(len(dictionary) - lz_min_match + 1):
+        lz_insert(dictionary, position, head, prev)
+    return (head, prev)
+
+def lz_match_length(buf, a, b, max_len):
+    length = 0
+    while length + 64 <= max_len and buf[a + length:a + length + 64] == buf[b + length:b + length + 64]:
+        length += 64
+    while length < max_len and buf[a + length] == buf[b + length]:
+        length += 1
+    return length
+
+def lz_compress(data, dictionary=b"", chains=None):
+    # Greedy, the longest match of the nearest lz_chain_depth candidates (the nearest wins ties)
+    if chains is None:
+        chains = lz_chains(dictionary)
+    head = chains[0].copy()
+    prev = chains[1] + [-1] * len(data)
+
+    buf = bytes(dictionary) + bytes(data)
+    n = len(buf)
+    output = bytearray()
+
+    i = len(dictionary)
+    anchor = i
+    while i < n:
+        best_len = 0
+        best_offset = 0
+        if i + lz_min_match <= n:
+            candidate = head.get(buf[i:i + lz_min_match], -1)
+            depth = 0
+            while candidate >= 0 and (i - candidate) <= lz_window and depth < lz_chain_depth:
+                length = lz_match_length(buf, candidate, i, n - i)
+                if length > best_len:
+                    best_len = length
+                    best_offset = i - candidate
+                    if length == n - i:
+                        break
+                candidate = prev[candidate]
+                depth += 1
+
+        if best_len >= lz_min_match:
+            lz_sequence(output, buf[anchor:i], best_offset, best_len)
+            end = i + best_len
+            while i < end:
+                if i + lz_min_match <= n:
+                    lz_insert(buf, i, head, prev)
+                i += 1
+            anchor = i
+        else:
+            if i + lz_min_match <= n:
+                lz_insert(buf, i, head, prev)
+            i += 1
+
+    if anchor < n:
+        # The last sequence has no match
+        lz_sequence(output, buf[anchor:n], 0, 0)
+
+    return output
+
+def lz_dictionary(planes_list):
+    # Planes of every stride-th saved frame, up to lz_dictionary_max bytes
+    total = sum(len(planes) for planes in planes_list)
+    stride = max(1, (total + lz_dictionary_max - 1) // lz_dictionary_max)
+    dictionary = bytearray()
+    for i, planes in enumerate(planes_list):
+        if i % stride == 0 and len(dictionary) + len(planes) <= lz_dictionary_max:
+            dictionary.extend(planes)
+    return bytes(dictionary)
+
+def mask_is_opaque(mask, rowbytes, bw, bh):
+    full_bytes = bw // 8
+    last_bits = (0xFF << (8 - bw % 8)) & 0xFF
+    for row in range(bh):
+        offset = row * rowbytes
+        if mask[offset:offset + full_bytes] != b"\xff" * full_bytes:
+            return False
+        if bw % 8 > 0 and (mask[offset + full_bytes] & last_bits) != last_bits:
+            return False
+    return True
+
+def fill_color(data, mask, rowbytes, bw, bh):
+    # Color of the visible pixels, or fill_none if they're not a single color
+    row_len = (bw + 7) // 8
+    last_bits = (0xFF << (8 - bw % 8)) & 0xFF if bw % 8 > 0 else 0xFF
+    black = False
+    white = False
+    for row in range(bh):
+        for i in range(row_len):
+            offset = row * rowbytes + i
+            visible = mask[offset]
+            if i == row_len - 1:
+                visible &= last_bits
+            if data[offset] & visible:
+                white = True
+            if ~data[offset] & visible:
+                black = True
+        if white and black:
+            return fill_none
+    return fill_white if white else fill_black
+
+def encode_image(im, compression, table=False):
     im = im.convert('RGBA')
     
     w, h = im.size
@@ -122,6 +265,14 @@ def encode_image(im):
                 mask_byte = 0b00000000
                 bit8_count = 0
 
+    fill = fill_none
+    if has_mask and mask_is_opaque(mask, rowbytes, bw, bh):
+        # Every visible pixel is opaque, drop the mask
+        has_mask = False
+    elif has_mask and format_version >= 7:
+        # Single color silhouette, drop the data plane
+        fill = fill_color(data, mask, rowbytes, bw, bh)
+
     output = bytearray()
     
     output.extend(format_version.to_bytes(4, byteorder="big"))
@@ -137,87 +288,274 @@ def encode_image(im):
     output.extend(has_mask_int.to_bytes(1, byteorder="big"))
     
     if format_version >= 3:
-        compressed_int = 1 if compressed else 0
-        output.extend(compressed_int.to_bytes(1, byteorder="big"))
+        output.extend(compression.to_bytes(1, byteorder="big"))
+
+    if format_version >= 7:
+        output.extend(fill.to_bytes(1, byteorder="big"))
 
     if format_version >= 2:
         add_padding(output)
 
-    if format_version >= 3 and compressed:
+    raw_data = bytes(data)
+    geometry = (w, h, bx, by, bw, bh, rowbytes, has_mask)
+    header = bytes(output)
+
+    planes = bytearray()
+    if fill == fill_none:
+        planes.extend(data)
+    if has_mask:
+        planes.extend(mask)
+
+    if format_version >= 9 and compression == compression_lz:
+        # Table frames are compressed with the table dictionary (see lz_table_frame)
+        if not table:
+            data = lz_compress(data)
+            if has_mask:
+                mask = lz_compress(mask)
+    elif format_version >= 3 and compression:
         data = compress(data, rowbytes, bh)
         if has_mask:
             mask = compress(mask, rowbytes, bh)
 
+    if fill == fill_none:
         output.extend(data)
-        if has_mask:
-            output.extend(mask)
-    else:
-        output.extend(data)
-        if has_mask:
-            output.extend(mask)
+    if has_mask:
+        output.extend(mask)
 
-    bufferLen = rowbytes * bh
+    bufferLen = 0
+    if fill == fill_none:
+        bufferLen += rowbytes * bh
     if has_mask:
         bufferLen += rowbytes * bh
 
-    return (output, bufferLen)
+    # Header and raw planes are used for the table dictionary
+    return (output, bufferLen, geometry, raw_data, header, bytes(planes))
+
+def delta_payload(previous, current, rowbytes, bh):
+    # Changed word runs, split by row
+    words = rowbytes // 4
+    runs = []
+    for row in range(bh):
+        row_offset = row * rowbytes
+        changed = [previous[row_offset + i * 4:row_offset + i * 4 + 4] != current[row_offset + i * 4:row_offset + i * 4 + 4] for i in range(words)]
+        i = 0
+        while i < words:
+            if not changed[i]:
+                i += 1
+                continue
+            start = i
+            end = i + 1
+            j = end
+            while j < words and (j - end) <= delta_max_gap:
+                if changed[j]:
+                    end = j + 1
+                j += 1
+            runs.append((row_offset + start * 4, (end - start) * 4))
+            i = end
+
+    payload = bytearray()
+    payload.extend(len(runs).to_bytes(4, byteorder="big"))
+    for offset, length in runs:
+        payload.extend(offset.to_bytes(4, byteorder="big"))
+        payload.extend(length.to_bytes(4, byteorder="big"))
+        payload.extend(current[offset:offset + length])
+    return payload
+
+def delta_candidate(tableImages, i, delta):
+    # Opaque frames with the same bounds as the previous one can be saved as changed word runs
+    if not delta or format_version < 6 or i == 0:
+        return False
+    geometry = tableImages[i][2]
+    return tableImages[i - 1][2] == geometry and not geometry[7]
+
+def table_frames(tableImages, delta, frame_sizes):
+    # Identical frames (same bounds and pixels) are saved as a reference to the first one
+    # A delta is used when it's smaller than the frame (frame_sizes for LZ tables)
+    frames = []
+    indexes = {}
+    for i, tableImage in enumerate(tableImages):
+        imageData = bytes(tableImage[0])
+        if format_version >= 5 and imageData in indexes:
+            frames.append(("reference", indexes[imageData]))
+            continue
+
+        if delta_candidate(tableImages, i, delta):
+            previous = tableImages[i - 1]
+            geometry = tableImage[2]
+            payload = delta_payload(previous[3], tableImage[3], geometry[6], geometry[5])
+            if len(payload) < frame_sizes.get(i, len(imageData)):
+                frames.append(("delta", payload))
+                continue
+
+        indexes[imageData] = i
+        frames.append(("frame", None))
+    return frames
+
+def lz_table_frame(tableImage, dictionary, chains):
+    # Each plane is matched against the dictionary, frames can be loaded in any order
+    geometry = tableImage[2]
+    plane_size = geometry[6] * geometry[5]
+    planes = tableImage[5]
+    frame = bytearray(tableImage[4])
+    for offset in range(0, len(planes), plane_size):
+        frame.extend(lz_compress(planes[offset:offset + plane_size], dictionary, chains))
+    return frame
+
+def lz_frame_size(tableImage):
+    # Size of the frame compressed on its own
+    return len(lz_table_frame(tableImage, b"", None))
+
+def save_table(path, tableImages, compression, frames, dictionary, payloads):
+    lz = format_version >= 9 and compression == compression_lz
+    dictionary_data = lz_compress(dictionary) if lz else b""
 
-def save_table(name, tableImages):
     data = bytearray()
 
     data.extend(format_version.to_bytes(4, byteorder="big"))
     data.extend(len(tableImages).to_bytes(4, byteorder="big"))
 
     if format_version >= 3:
-        compressed_int = 1 if compressed else 0
-        data.extend(compressed_int.to_bytes(1, byteorder="big"))
+        data.extend(compression.to_bytes(1, byteorder="big"))
 
-        if format_version >= 4 and compressed:
+        if format_version >= 4 and compression:
             bufferLen = 0
-            for tableImage in tableImages:
-                bufferLen += tableImage[1]
+            for tableImage, frame in zip(tableImages, frames):
+                if frame[0] == "frame":
+                    bufferLen += tableImage[1]
             data.extend(bufferLen.to_bytes(4, byteorder="big"))
 
+        if lz:
+            # Version 9: dictionary size and compressed length
+            data.extend(len(dictionary).to_bytes(4, byteorder="big"))
+            data.extend(len(dictionary_data).to_bytes(4, byteorder="big"))
+
     if format_version >= 2:
         add_padding(data)
 
-    for tableImage in tableImages:
-        data.extend(len(tableImage[0]).to_bytes(4, byteorder="big"))
-        data.extend(tableImage[0])
-
-    result_filename = name + ".hebt"
-    f = open(os.path.join(output_dir, result_filename), "wb")
+    entries = []
+    for i, (tableImage, frame) in enumerate(zip(tableImages, frames)):
+        kind, value = frame
+        if kind == "reference":
+            entries.append(((frame_reference | value), None))
+        elif kind == "delta":
+            entries.append(((frame_delta | len(value)), value))
+        elif lz:
+            payload = payloads[i]
+            entries.append((len(payload), payload))
+        else:
+            entries.append((len(tableImage[0]), tableImage[0]))
+
+    if format_version >= 8:
+        # Version 8: offset and size of each frame, version 9: the dictionary follows the index
+        offset = len(data) + len(entries) * 8 + len(dictionary_data)
+        for size, payload in entries:
+            if payload is None:
+                data.extend((0).to_bytes(4, byteorder="big"))
+                offset += 4
+            else:
+                data.extend((offset + 4).to_bytes(4, byteorder="big"))
+                offset += 4 + len(payload)
+            data.extend(size.to_bytes(4, byteorder="big"))
+
+    data.extend(dictionary_data)
+
+    for size, payload in entries:
+        data.extend(size.to_bytes(4, byteorder="big"))
+        if payload is not None:
+            data.extend(payload)
+
+    f = open(path, "wb")
     f.write(data)
     f.close()
 
-input_file = os.path.join(working_dir, input_arg)
-if os.path.isabs(input_arg):
-    input_file = input_arg
-    output_dir = os.path.dirname(input_arg)
+def save_image(path, imageData):
+    f = open(path, "wb")
+    f.write(imageData)
+    f.close()
 
-if os.path.isfile(input_file):
-    filename = os.path.basename(input_file)
-    filename_no_ext = os.path.splitext(filename)[0]
-    
-    im = Image.open(input_file)
-    
-    if im.format == "GIF" and im.is_animated:
-        tableImages = []
-        for frame in ImageSequence.Iterator(im):
-            tableImages.append(encode_image(frame))
-        
-        save_table(filename_no_ext, tableImages)
-    else:
-        (imageData, bufferLen) = encode_image(im)
-        result_filename = filename_no_ext + ".heb"
+def c_array_path(path):
+    return os.path.splitext(path)[0] + ".h"
 
-        f = open(os.path.join(output_dir, result_filename), "wb")
-        f.write(imageData)
-        f.close()
-elif os.path.isdir(input_file):
-    input_dir = input_file
-    dirname = os.path.basename(input_dir)
+def save_c_array(path):
+    # Aligned for HEBitmap_fromMemory / HEBitmapTable_fromMemory, planes are used in place
+    f = open(path, "rb")
+    data = f.read()
+    f.close()
+
+    filename = os.path.basename(path)
+    name = re.sub("[^0-9a-zA-Z_]", "_", filename)
+    if name[0].isdigit():
+        name = "_" + name
+    guard = name.upper() + "_H"
+
+    lines = []
+    lines.append("// Generated by encoder.py from " + filename)
+    lines.append("#ifndef " + guard)
+    lines.append("#define " + guard)
+    lines.append("")
+    lines.append("#include <stdint.h>")
+    lines.append("#include <stddef.h>")
+    lines.append("")
+    lines.append("#define " + name.upper() + "_LEN " + str(len(data)))
+    lines.append("")
+    # Extra word for the kernel look-ahead
+    lines.append("static const uint8_t " + name + "[" + str(len(data) + 4) + "] __attribute__((aligned(32))) = {")
+    padded = data + bytes(4)
+    for i in range(0, len(padded), 16):
+        lines.append("    " + ", ".join("0x%02x" % byte for byte in padded[i:(i+16)]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif")
+
+    f = open(c_array_path(path), "w")
+    f.write("\n".join(lines) + "\n")
+    f.close()
 
+# jobs
+
+def encode_file_job(job):
+    filename, compression, table = job
+    im = Image.open(filename)
+    return [encode_image(im, compression, table)]
+
+def encode_gif_job(job):
+    # GIF frames depend on the previous frame, they're decoded in order
+    filename, compression, table = job
+    im = Image.open(filename)
+    return [encode_image(frame, compression, table) for frame in ImageSequence.Iterator(im)]
+
+# chains of the last dictionary, jobs of the same table share them
+lz_job_chains = (None, None)
+
+def lz_frame_job(job):
+    global lz_job_chains
+    tableImage, dictionary = job
+    if lz_job_chains[0] != dictionary:
+        lz_job_chains = (dictionary, lz_chains(dictionary))
+    return lz_table_frame(tableImage, dictionary, lz_job_chains[1])
+
+def run_job(job):
+    kind, args = job
+    if kind == "gif":
+        return encode_gif_job(args)
+    if kind == "lz_size":
+        return lz_frame_size(args)
+    if kind == "lz_frame":
+        return lz_frame_job(args)
+    return encode_file_job(args)
+
+def map_jobs(pool, jobs):
+    if pool is None or len(jobs) <= 1:
+        return [run_job(job) for job in jobs]
+    return pool.map(run_job, jobs, chunksize=1)
+
+# assets
+
+def is_animated_gif(filename):
+    im = Image.open(filename)
+    return im.format == "GIF" and im.is_animated
+
+def table_files_in_dir(input_dir):
     tableFiles = []
     for filename in os.listdir(input_dir):
         filepath = os.path.join(input_dir, filename)
@@ -227,16 +565,204 @@ elif os.path.isdir(input_file):
             name = match[1]
             index = int(match[2])
             tableFiles.append((index, name, filepath))
-    
-    tableFiles = sorted(tableFiles, key=lambda file: file[0])
 
-    if len(tableFiles) > 0:
-        tableName = tableFiles[0][1]
+    return sorted(tableFiles, key=lambda file: file[0])
+
+def file_asset(input_file, output_dir):
+    # (output path, input files, jobs, is table)
+    filename_no_ext = os.path.splitext(os.path.basename(input_file))[0]
+    if is_animated_gif(input_file):
+        output_path = os.path.join(output_dir, filename_no_ext + ".hebt")
+        return (output_path, [input_file], [("gif", input_file)], True)
+
+    output_path = os.path.join(output_dir, filename_no_ext + ".heb")
+    return (output_path, [input_file], [("file", input_file)], False)
+
+def table_asset(input_dir, output_dir):
+    tableFiles = table_files_in_dir(input_dir)
+    if len(tableFiles) == 0:
+        return None
+
+    tableName = tableFiles[0][1]
+    files = [tableFile[2] for tableFile in tableFiles]
+    output_path = os.path.join(output_dir, tableName + ".hebt")
+    return (output_path, files, [("file", filename) for filename in files], True)
+
+def batch_assets(root_dir):
+    assets = []
+    for dirpath, dirnames, filenames in os.walk(root_dir):
+        dirnames.sort()
+        for filename in sorted(filenames):
+            filepath = os.path.join(dirpath, filename)
+            filename_no_ext, ext = os.path.splitext(filename)
+            if ext.lower() not in image_extensions:
+                continue
+            if re.search("(.+)-table-([0-9]+)$", filename_no_ext):
+                continue
+            assets.append(file_asset(filepath, dirpath))
+
+        # Image table folder, saved next to the folder
+        table_output_dir = dirpath if dirpath == root_dir else os.path.dirname(dirpath)
+        asset = table_asset(dirpath, table_output_dir)
+        if asset:
+            assets.append(asset)
+    return assets
+
+def asset_hash(asset, compression, delta):
+    output_path, files, jobs, is_table = asset
+
+    h = hashlib.sha256()
+    h.update(("%d %d %d" % (format_version, compression, 1 if delta else 0)).encode())
+    for filename in files:
+        h.update(os.path.basename(filename).encode())
+        f = open(filename, "rb")
+        h.update(hashlib.sha256(f.read()).digest())
+        f.close()
+    return h.hexdigest()
+
+def load_cache(path):
+    try:
+        f = open(path, "r")
+        cache = json.load(f)
+        f.close()
+        if cache.get("version") == 1:
+            return cache["assets"]
+    except (OSError, ValueError, KeyError):
+        pass
+    return {}
+
+def save_cache(path, assets):
+    f = open(path, "w")
+    json.dump({"version": 1, "assets": assets}, f, indent=1, sort_keys=True)
+    f.close()
+
+def encode_assets(assets, compression, delta, processes, c_array):
+    # All frames of all assets are encoded in a single pool
+    lz = format_version >= 9 and compression == compression_lz
+    lz_tables = lz and any(asset[3] for asset in assets)
+
+    jobs = []
+    for asset in assets:
+        for job in asset[2]:
+            kind, filename = job
+            jobs.append((kind, (filename, compression, asset[3])))
+
+    pool = None
+    if processes > 1 and (len(jobs) > 1 or lz_tables):
+        pool = multiprocessing.Pool(processes)
 
+    results = map_jobs(pool, jobs)
+
+    assetImages = []
+    index = 0
+    for asset in assets:
         tableImages = []
-        for tableFile in tableFiles:
-            filename = tableFile[2]
-            im = Image.open(filename)
-            tableImages.append(encode_image(im))
-        
-        save_table(tableName, tableImages)
\ No newline at end of file
+        for _ in asset[2]:
+            tableImages.extend(results[index])
+            index += 1
+        assetImages.append(tableImages)
+
+    # LZ tables: a delta is compared with the frame compressed on its own
+    frame_sizes = [{} for asset in assets]
+    if lz_tables and delta:
+        keys = [(a, i) for a, asset in enumerate(assets) if asset[3] for i in range(len(assetImages[a])) if delta_candidate(assetImages[a], i, delta)]
+        sizes = map_jobs(pool, [("lz_size", assetImages[a][i]) for a, i in keys])
+        for (a, i), size in zip(keys, sizes):
+            frame_sizes[a][i] = size
+
+    frames = [table_frames(assetImages[a], delta, frame_sizes[a]) if asset[3] else None for a, asset in enumerate(assets)]
+
+    # LZ tables: saved frames are compressed with the table dictionary
+    dictionaries = [b"" for asset in assets]
+    payloads = [{} for asset in assets]
+    if lz_tables:
+        keys = []
+        for a, asset in enumerate(assets):
+            if asset[3]:
+                dictionaries[a] = lz_dictionary([tableImage[5] for tableImage, frame in zip(assetImages[a], frames[a]) if frame[0] == "frame"])
+                keys.extend((a, i) for i, frame in enumerate(frames[a]) if frame[0] == "frame")
+        results = map_jobs(pool, [("lz_frame", (assetImages[a][i], dictionaries[a])) for a, i in keys])
+        for (a, i), payload in zip(keys, results):
+            payloads[a][i] = payload
+
+    if pool is not None:
+        pool.close()
+        pool.join()
+
+    for a, asset in enumerate(assets):
+        output_path, files, asset_jobs, is_table = asset
+        tableImages = assetImages[a]
+
+        if is_table:
+            save_table(output_path, tableImages, compression, frames[a], dictionaries[a], payloads[a])
+        else:
+            save_image(output_path, tableImages[0][0])
+
+        if c_array:
+            save_c_array(output_path)
+
+def run_batch(root_dir, compression, delta, processes, force, c_array):
+    cache_path = os.path.join(root_dir, cache_filename)
+    cache = {} if force else load_cache(cache_path)
+
+    assets = batch_assets(root_dir)
+
+    hashes = {}
+    dirty_assets = []
+    for asset in assets:
+        key = os.path.relpath(asset[0], root_dir)
+        hashes[key] = asset_hash(asset, compression, delta)
+        if cache.get(key) != hashes[key] or not os.path.isfile(asset[0]) or (c_array and not os.path.isfile(c_array_path(asset[0]))):
+            dirty_assets.append(asset)
+
+    encode_assets(dirty_assets, compression, delta, processes, c_array)
+    save_cache(cache_path, hashes)
+
+    print("Encoded %d of %d assets" % (len(dirty_assets), len(assets)))
+
+def main():
+    parser = argparse.ArgumentParser(description="HEBitmap Encoder")
+    parser.add_argument('-i', "--input", help="input file. You can pass in a file or a folder containing a Playdate image table (name-table-1.png, name-table-2.png, ...). Compression is enabled by default.")
+    parser.add_argument('-r', "--raw", help="Save the file as raw data (no compression).", required=False, action='store_true')
+    parser.add_argument("--lz", help="Compress with LZ sequences, table frames share a dictionary (slower to encode, smaller tables).", required=False, action='store_true')
+    parser.add_argument("--delta", help="Save opaque table frames as changed words from the previous frame (for HEBitmapTable_drawNextFrame).", required=False, action='store_true')
+    parser.add_argument('-b', "--batch", help="Encode all the images and image tables in a directory tree. Unchanged assets are skipped (see .hebcache).")
+    parser.add_argument('-j', "--jobs", help="Number of processes (default: all cores).", type=int, default=0)
+    parser.add_argument('-f', "--force", help="Ignore the batch cache.", required=False, action='store_true')
+    parser.add_argument("--c-array", help="Also save the file as an aligned C array header (for HEBitmap_fromMemory). Implies --raw.", required=False, action='store_true')
+
+    args = parser.parse_args()
+
+    if not args.input and not args.batch:
+        parser.error("one of -i/--input or -b/--batch is required")
+
+    compression = compression_lz if args.lz else compression_rle
+    if args.raw or args.c_array:
+        compression = compression_none
+    processes = args.jobs if args.jobs > 0 else os.cpu_count()
+
+    working_dir = os.getcwd()
+
+    if args.batch:
+        run_batch(os.path.normpath(os.path.join(working_dir, args.batch)), compression, args.delta, processes, args.force, args.c_array)
+        return
+
+    input_arg = args.input
+    output_dir = working_dir
+
+    input_file = os.path.join(working_dir, input_arg)
+    if os.path.isabs(input_arg):
+        input_file = input_arg
+        output_dir = os.path.dirname(input_arg)
+
+    asset = None
+    if os.path.isfile(input_file):
+        asset = file_asset(input_file, output_dir)
+    elif os.path.isdir(input_file):
+        asset = table_asset(input_file, output_dir)
+
+    if asset:
+        encode_assets([asset], compression, args.delta, processes, args.c_array)
+
+if __name__ == "__main__":
+    main()
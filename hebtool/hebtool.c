@@ -0,0 +1,1404 @@
+//
+//  hebtool.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "he_format.h"
+#include "hebtool_image.h"
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t bufferLen;
+    HEFormatBitmapHeader header;
+    size_t headerLen;
+    uint8_t *raw;
+    uint8_t *planes;
+} HTBuffer;
+
+typedef struct {
+    HEFormatBitmapHeader header;
+    uint8_t *data;
+    uint8_t *mask;
+} HTPlanes;
+
+typedef struct {
+    int index;
+    char *name;
+    char *path;
+} HTTableFile;
+
+typedef enum {
+    HTFrameKindFull,
+    HTFrameKindReference,
+    HTFrameKindDelta
+} HTFrameKind;
+
+// Unchanged words merged into a delta run (a run header is 8 bytes)
+#define HT_DELTA_MAX_GAP 2
+
+// LZ matcher, candidates with the same 4 bytes are checked from the nearest
+#define HT_LZ_CHAIN_DEPTH 16
+#define HT_LZ_HASH_BITS 16
+
+static int compressed = HE_FORMAT_COMPRESSION_RLE;
+static int delta = 0;
+static int lz = 0;
+static char output_dir[4096];
+
+static void ht_buffer_append(HTBuffer *buffer, const uint8_t *data, size_t len)
+{
+    buffer->data = realloc(buffer->data, buffer->len + len);
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+}
+
+static int ht_write_file(const char *filename, const uint8_t *data, size_t len)
+{
+    FILE *file = fopen(filename, "wb");
+    if(!file)
+    {
+        fprintf(stderr, "hebtool: cannot write %s\n", filename);
+        return 0;
+    }
+    size_t written = fwrite(data, 1, len, file);
+    fclose(file);
+    return written == len;
+}
+
+// Writes dir/name where name is formatted, fails if the path doesn't fit
+static int ht_path_join(char *dst, size_t dst_len, const char *dir, const char *format, ...)
+{
+    int dir_len = snprintf(dst, dst_len, "%s/", dir);
+    if(dir_len >= 0 && (size_t)dir_len < dst_len)
+    {
+        va_list args;
+        va_start(args, format);
+        int name_len = vsnprintf(dst + dir_len, dst_len - dir_len, format, args);
+        va_end(args);
+        
+        if(name_len >= 0 && (size_t)name_len < (dst_len - dir_len))
+        {
+            return 1;
+        }
+    }
+    fprintf(stderr, "hebtool: path too long in %s\n", dir);
+    return 0;
+}
+
+static const char* ht_basename(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? (slash + 1) : path;
+}
+
+static void ht_strip_extension(char *dst, size_t dst_len, const char *filename)
+{
+    snprintf(dst, dst_len, "%s", filename);
+    // Leading dots are not extensions (same as os.path.splitext)
+    char *name = dst;
+    while(*name == '.')
+    {
+        name++;
+    }
+    char *dot = strrchr(name, '.');
+    if(dot)
+    {
+        *dot = '\0';
+    }
+}
+
+//
+// Encoder (same output as encoder.py)
+//
+static size_t ht_lz_length(uint8_t *dst, size_t length)
+{
+    // Extended length, continues while the byte is 255
+    size_t len = 0;
+    while(length >= 255)
+    {
+        dst[len++] = 255;
+        length -= 255;
+    }
+    dst[len++] = (uint8_t)length;
+    return len;
+}
+
+static size_t ht_lz_sequence(uint8_t *dst, const uint8_t *literals, size_t literals_len, size_t offset, size_t match_len)
+{
+    size_t len = 0;
+    
+    uint8_t token = (uint8_t)((literals_len < 15 ? literals_len : 15) << 4);
+    if(match_len > 0)
+    {
+        size_t match_token = match_len - HE_FORMAT_LZ_MIN_MATCH;
+        token |= (match_token < 15) ? match_token : 15;
+    }
+    dst[len++] = token;
+    
+    if(literals_len >= 15)
+    {
+        len += ht_lz_length(dst + len, literals_len - 15);
+    }
+    memcpy(dst + len, literals, literals_len);
+    len += literals_len;
+    
+    if(match_len > 0)
+    {
+        dst[len++] = (offset >> 8) & 0xFF;
+        dst[len++] = offset & 0xFF;
+        if((match_len - HE_FORMAT_LZ_MIN_MATCH) >= 15)
+        {
+            len += ht_lz_length(dst + len, match_len - HE_FORMAT_LZ_MIN_MATCH - 15);
+        }
+    }
+    
+    return len;
+}
+
+static uint32_t ht_lz_hash(const uint8_t *src)
+{
+    return (he_format_read_uint32(src) * 2654435761u) >> (32 - HT_LZ_HASH_BITS);
+}
+
+static void ht_lz_insert(const uint8_t *buf, size_t position, int32_t *head, int32_t *prev)
+{
+    uint32_t hash = ht_lz_hash(buf + position);
+    prev[position] = head[hash];
+    head[hash] = (int32_t)position;
+}
+
+static void ht_lz_compress(HTBuffer *output, const uint8_t *src, size_t len, const uint8_t *dictionary, size_t dictionary_len)
+{
+    // Greedy, the longest match of the nearest HT_LZ_CHAIN_DEPTH candidates (the nearest wins ties)
+    size_t n = dictionary_len + len;
+    uint8_t *buf = malloc(n + 1);
+    if(dictionary_len > 0)
+    {
+        memcpy(buf, dictionary, dictionary_len);
+    }
+    memcpy(buf + dictionary_len, src, len);
+    
+    int32_t *head = malloc(sizeof(int32_t) << HT_LZ_HASH_BITS);
+    int32_t *prev = malloc(sizeof(int32_t) * (n + 1));
+    for(size_t i = 0; i < ((size_t)1 << HT_LZ_HASH_BITS); i++)
+    {
+        head[i] = -1;
+    }
+    
+    // Dictionary positions with 4 bytes in the dictionary
+    for(size_t i = 0; (i + HE_FORMAT_LZ_MIN_MATCH) <= dictionary_len; i++)
+    {
+        ht_lz_insert(buf, i, head, prev);
+    }
+    
+    uint8_t *dst = malloc(len + len / 255 + 16);
+    size_t dst_len = 0;
+    
+    size_t i = dictionary_len;
+    size_t anchor = i;
+    
+    while(i < n)
+    {
+        size_t best_len = 0;
+        size_t best_offset = 0;
+        
+        if((i + HE_FORMAT_LZ_MIN_MATCH) <= n)
+        {
+            int32_t candidate = head[ht_lz_hash(buf + i)];
+            int depth = 0;
+            
+            while(candidate >= 0 && (i - candidate) <= HE_FORMAT_LZ_WINDOW && depth < HT_LZ_CHAIN_DEPTH)
+            {
+                // Hash collisions are not candidates
+                if(memcmp(buf + candidate, buf + i, HE_FORMAT_LZ_MIN_MATCH) == 0)
+                {
+                    size_t length = 0;
+                    while(length < (n - i) && buf[candidate + length] == buf[i + length])
+                    {
+                        length++;
+                    }
+                    if(length > best_len)
+                    {
+                        best_len = length;
+                        best_offset = i - candidate;
+                        if(length == (n - i))
+                        {
+                            break;
+                        }
+                    }
+                    depth++;
+                }
+                candidate = prev[candidate];
+            }
+        }
+        
+        if(best_len >= HE_FORMAT_LZ_MIN_MATCH)
+        {
+            dst_len += ht_lz_sequence(dst + dst_len, buf + anchor, i - anchor, best_offset, best_len);
+            size_t end = i + best_len;
+            for(; i < end; i++)
+            {
+                if((i + HE_FORMAT_LZ_MIN_MATCH) <= n)
+                {
+                    ht_lz_insert(buf, i, head, prev);
+                }
+            }
+            anchor = i;
+        }
+        else
+        {
+            if((i + HE_FORMAT_LZ_MIN_MATCH) <= n)
+            {
+                ht_lz_insert(buf, i, head, prev);
+            }
+            i++;
+        }
+    }
+    
+    if(anchor < n)
+    {
+        // The last sequence has no match
+        dst_len += ht_lz_sequence(dst + dst_len, buf + anchor, n - anchor, 0, 0);
+    }
+    
+    ht_buffer_append(output, dst, dst_len);
+    
+    free(dst);
+    free(prev);
+    free(head);
+    free(buf);
+}
+
+static HTBuffer ht_encode_image(const HTImage *image)
+{
+    int w = image->width;
+    int h = image->height;
+    
+    // Alpha bounding box
+    int bx = w, by = h, b_right = 0, b_bottom = 0;
+    for(int y = 0; y < h; y++)
+    {
+        for(int x = 0; x < w; x++)
+        {
+            if(image->rgba[((size_t)y * w + x) * 4 + 3] != 0)
+            {
+                if(x < bx) bx = x;
+                if(y < by) by = y;
+                if(x >= b_right) b_right = x + 1;
+                if(y >= b_bottom) b_bottom = y + 1;
+            }
+        }
+    }
+    if(b_right == 0)
+    {
+        bx = 0;
+        by = 0;
+        b_right = w;
+        b_bottom = h;
+    }
+    
+    int bw = b_right - bx;
+    int bh = b_bottom - by;
+    
+    int rowbytes = ((bw + 31) / 32) * 4;
+    size_t plane_size = (size_t)rowbytes * bh;
+    
+    uint8_t *data = calloc(plane_size + 1, 1);
+    uint8_t *mask = calloc(plane_size + 1, 1);
+    int has_mask = 0;
+    
+    for(int y = 0; y < bh; y++)
+    {
+        for(int x = 0; x < bw; x++)
+        {
+            const uint8_t *pixel = image->rgba + ((size_t)(by + y) * w + (bx + x)) * 4;
+            double r = pixel[0], g = pixel[1], b = pixel[2];
+            uint8_t a = pixel[3];
+            
+            if(a <= 127)
+            {
+                has_mask = 1;
+            }
+            
+            // Round half to even, like Python's round()
+            long color = lrint(0.2125 * r + 0.7154 * g + 0.0721 * b);
+            
+            size_t i = (size_t)y * rowbytes + x / 8;
+            uint8_t bit = 1 << (7 - (x % 8));
+            
+            if(color >= 127)
+            {
+                data[i] |= bit;
+            }
+            if(a >= 127)
+            {
+                mask[i] |= bit;
+            }
+        }
+    }
+    
+    uint8_t fill = HE_FORMAT_FILL_NONE;
+    if(has_mask && he_format_mask_is_opaque(mask, rowbytes, bw, bh))
+    {
+        // Every visible pixel is opaque, drop the mask
+        has_mask = 0;
+    }
+    else if(has_mask)
+    {
+        // Single color silhouette, drop the data plane
+        fill = he_format_fill(data, mask, rowbytes, bw, bh);
+    }
+    
+    HEFormatBitmapHeader header = {
+        .version = HE_FORMAT_VERSION,
+        .width = w,
+        .height = h,
+        .bx = bx,
+        .by = by,
+        .bw = bw,
+        .bh = bh,
+        .rowbytes = rowbytes,
+        .hasMask = has_mask,
+        .compressed = compressed,
+        .fill = fill
+    };
+    
+    HTBuffer output = {0};
+    
+    uint8_t header_data[64];
+    size_t header_len = he_format_write_bitmap_header(header_data, &header);
+    ht_buffer_append(&output, header_data, header_len);
+    
+    int planes = 0;
+    uint8_t *plane_data[2];
+    if(fill == HE_FORMAT_FILL_NONE)
+    {
+        plane_data[planes++] = data;
+    }
+    if(has_mask)
+    {
+        plane_data[planes++] = mask;
+    }
+    
+    uint8_t *raw_planes = malloc(plane_size * planes + 1);
+    
+    for(int i = 0; i < planes; i++)
+    {
+        memcpy(raw_planes + plane_size * i, plane_data[i], plane_size);
+        
+        if(compressed == HE_FORMAT_COMPRESSION_LZ)
+        {
+            ht_lz_compress(&output, plane_data[i], plane_size, NULL, 0);
+        }
+        else if(compressed)
+        {
+            uint8_t *compressed_data = malloc(he_format_compress_bound(plane_size) + 1);
+            size_t compressed_len = he_format_compress(compressed_data, plane_data[i], plane_size);
+            ht_buffer_append(&output, compressed_data, compressed_len);
+            free(compressed_data);
+        }
+        else
+        {
+            ht_buffer_append(&output, plane_data[i], plane_size);
+        }
+    }
+    
+    output.bufferLen = plane_size * planes;
+    output.header = header;
+    output.headerLen = header_len;
+    output.raw = data;
+    // Header and raw planes are used for the table dictionary
+    output.planes = raw_planes;
+    
+    free(mask);
+    
+    return output;
+}
+
+static int ht_find_reference(HTBuffer *images, int *kinds, int index)
+{
+    // Identical frames (same bounds and pixels) are saved as a reference to the first one
+    for(int i = 0; i < index; i++)
+    {
+        if(kinds[i] == HTFrameKindFull && images[i].len == images[index].len && memcmp(images[i].data, images[index].data, images[i].len) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static HTBuffer ht_delta_payload(const HTBuffer *previous, const HTBuffer *current)
+{
+    // Changed word runs, split by row
+    HTBuffer payload = {0};
+    
+    uint32_t rowbytes = current->header.rowbytes;
+    uint32_t words = rowbytes / 4;
+    uint32_t runs_count = 0;
+    
+    uint8_t value[4] = {0};
+    ht_buffer_append(&payload, value, 4);
+    
+    for(uint32_t row = 0; row < current->header.bh; row++)
+    {
+        size_t row_offset = (size_t)row * rowbytes;
+        const uint8_t *previous_row = previous->raw + row_offset;
+        const uint8_t *current_row = current->raw + row_offset;
+        
+        uint32_t i = 0;
+        while(i < words)
+        {
+            if(memcmp(previous_row + i * 4, current_row + i * 4, 4) == 0)
+            {
+                i++;
+                continue;
+            }
+            
+            uint32_t start = i;
+            uint32_t end = i + 1;
+            for(uint32_t j = end; j < words && (j - end) <= HT_DELTA_MAX_GAP; j++)
+            {
+                if(memcmp(previous_row + j * 4, current_row + j * 4, 4) != 0)
+                {
+                    end = j + 1;
+                }
+            }
+            
+            he_format_write_uint32(value, (uint32_t)(row_offset + start * 4));
+            ht_buffer_append(&payload, value, 4);
+            he_format_write_uint32(value, (end - start) * 4);
+            ht_buffer_append(&payload, value, 4);
+            ht_buffer_append(&payload, current_row + start * 4, (end - start) * 4);
+            
+            runs_count++;
+            i = end;
+        }
+    }
+    
+    he_format_write_uint32(payload.data, runs_count);
+    
+    return payload;
+}
+
+static int ht_same_geometry(const HEFormatBitmapHeader *a, const HEFormatBitmapHeader *b)
+{
+    return a->width == b->width && a->height == b->height && a->bx == b->bx && a->by == b->by && a->bw == b->bw && a->bh == b->bh && a->rowbytes == b->rowbytes && a->hasMask == b->hasMask;
+}
+
+static uint8_t* ht_lz_dictionary(HTBuffer *images, int *kinds, int length, size_t *dictionary_len)
+{
+    // Planes of every stride-th saved frame, up to HE_FORMAT_LZ_DICTIONARY_MAX bytes
+    size_t total = 0;
+    for(int i = 0; i < length; i++)
+    {
+        if(kinds[i] == HTFrameKindFull)
+        {
+            total += images[i].bufferLen;
+        }
+    }
+    
+    size_t stride = (total + HE_FORMAT_LZ_DICTIONARY_MAX - 1) / HE_FORMAT_LZ_DICTIONARY_MAX;
+    if(stride < 1)
+    {
+        stride = 1;
+    }
+    
+    uint8_t *dictionary = malloc(HE_FORMAT_LZ_DICTIONARY_MAX + 1);
+    size_t len = 0;
+    size_t frame = 0;
+    
+    if(!dictionary)
+    {
+        *dictionary_len = 0;
+        return NULL;
+    }
+    
+    for(int i = 0; i < length; i++)
+    {
+        if(kinds[i] != HTFrameKindFull)
+        {
+            continue;
+        }
+        if((frame % stride) == 0 && (len + images[i].bufferLen) <= HE_FORMAT_LZ_DICTIONARY_MAX)
+        {
+            memcpy(dictionary + len, images[i].planes, images[i].bufferLen);
+            len += images[i].bufferLen;
+        }
+        frame++;
+    }
+    
+    // Frames larger than the dictionary are compressed on their own
+    if(len == 0)
+    {
+        free(dictionary);
+        dictionary = NULL;
+    }
+    
+    *dictionary_len = len;
+    return dictionary;
+}
+
+static HTBuffer ht_lz_table_frame(const HTBuffer *image, const uint8_t *dictionary, size_t dictionary_len)
+{
+    // Each plane is matched against the dictionary, frames can be loaded in any order
+    HTBuffer frame = {0};
+    ht_buffer_append(&frame, image->data, image->headerLen);
+    
+    size_t plane_size = (size_t)image->header.rowbytes * image->header.bh;
+    for(size_t offset = 0; offset < image->bufferLen; offset += plane_size)
+    {
+        ht_lz_compress(&frame, image->planes + offset, plane_size, dictionary, dictionary_len);
+    }
+    
+    return frame;
+}
+
+static int ht_save_table(const char *name, HTBuffer *images, int length)
+{
+    int *kinds = malloc(sizeof(int) * length);
+    int *references = malloc(sizeof(int) * length);
+    HTBuffer *deltas = calloc(length, sizeof(HTBuffer));
+    
+    uint32_t allocatorSize = 0;
+    for(int i = 0; i < length; i++)
+    {
+        references[i] = ht_find_reference(images, kinds, i);
+        if(references[i] >= 0)
+        {
+            kinds[i] = HTFrameKindReference;
+            continue;
+        }
+        
+        // Opaque frames with the same bounds as the previous one can be saved as changed word runs
+        if(delta && i > 0 && ht_same_geometry(&images[i - 1].header, &images[i].header) && !images[i].header.hasMask)
+        {
+            deltas[i] = ht_delta_payload(&images[i - 1], &images[i]);
+            if(deltas[i].len < images[i].len)
+            {
+                kinds[i] = HTFrameKindDelta;
+                continue;
+            }
+            free(deltas[i].data);
+            deltas[i] = (HTBuffer){0};
+        }
+        
+        kinds[i] = HTFrameKindFull;
+        allocatorSize += (uint32_t)images[i].bufferLen;
+    }
+    
+    // Saved frames, re-encoded with the dictionary for LZ
+    HTBuffer *payloads = images;
+    HTBuffer dictionary_data = {0};
+    size_t dictionary_len = 0;
+    
+    if(compressed == HE_FORMAT_COMPRESSION_LZ)
+    {
+        uint8_t *dictionary = ht_lz_dictionary(images, kinds, length, &dictionary_len);
+        if(dictionary)
+        {
+            ht_lz_compress(&dictionary_data, dictionary, dictionary_len, NULL, 0);
+        }
+        else
+        {
+            dictionary_len = 0;
+        }
+        
+        payloads = calloc(length, sizeof(HTBuffer));
+        for(int i = 0; i < length; i++)
+        {
+            if(kinds[i] == HTFrameKindFull)
+            {
+                payloads[i] = ht_lz_table_frame(&images[i], dictionary, dictionary_len);
+            }
+        }
+        free(dictionary);
+    }
+    
+    HEFormatTableHeader header = {
+        .version = HE_FORMAT_VERSION,
+        .length = length,
+        .compressed = compressed,
+        .allocatorSize = allocatorSize,
+        .dictionarySize = (uint32_t)dictionary_len,
+        .dictionaryLength = (uint32_t)dictionary_data.len
+    };
+    
+    HTBuffer output = {0};
+    
+    uint8_t header_data[64];
+    size_t header_len = he_format_write_table_header(header_data, &header);
+    ht_buffer_append(&output, header_data, header_len);
+    
+    HEFormatFrameIndex *entries = malloc(sizeof(HEFormatFrameIndex) * length);
+    // Version 9: the dictionary follows the index
+    size_t offset = header_len + he_format_table_index_size(HE_FORMAT_VERSION, length) + dictionary_data.len;
+    
+    for(int i = 0; i < length; i++)
+    {
+        size_t payload_len = 0;
+        if(kinds[i] == HTFrameKindReference)
+        {
+            entries[i].size = HE_FORMAT_FRAME_REFERENCE | (uint32_t)references[i];
+        }
+        else if(kinds[i] == HTFrameKindDelta)
+        {
+            entries[i].size = HE_FORMAT_FRAME_DELTA | (uint32_t)deltas[i].len;
+            payload_len = deltas[i].len;
+        }
+        else
+        {
+            entries[i].size = (uint32_t)payloads[i].len;
+            payload_len = payloads[i].len;
+        }
+        
+        // Version 8: offset of the frame data, references have no data
+        entries[i].offset = (kinds[i] == HTFrameKindReference) ? 0 : (uint32_t)(offset + 4);
+        offset += 4 + payload_len;
+        
+        uint8_t index_data[HE_FORMAT_FRAME_INDEX_SIZE];
+        he_format_write_uint32(index_data, entries[i].offset);
+        he_format_write_uint32(index_data + 4, entries[i].size);
+        ht_buffer_append(&output, index_data, HE_FORMAT_FRAME_INDEX_SIZE);
+    }
+    
+    if(dictionary_data.len > 0)
+    {
+        ht_buffer_append(&output, dictionary_data.data, dictionary_data.len);
+    }
+    
+    for(int i = 0; i < length; i++)
+    {
+        uint8_t size_data[4];
+        he_format_write_uint32(size_data, entries[i].size);
+        ht_buffer_append(&output, size_data, 4);
+        
+        if(kinds[i] == HTFrameKindDelta)
+        {
+            ht_buffer_append(&output, deltas[i].data, deltas[i].len);
+        }
+        else if(kinds[i] == HTFrameKindFull)
+        {
+            ht_buffer_append(&output, payloads[i].data, payloads[i].len);
+        }
+    }
+    
+    free(entries);
+    
+    if(payloads != images)
+    {
+        for(int i = 0; i < length; i++)
+        {
+            free(payloads[i].data);
+        }
+        free(payloads);
+    }
+    free(dictionary_data.data);
+    
+    for(int i = 0; i < length; i++)
+    {
+        free(deltas[i].data);
+    }
+    free(deltas);
+    free(references);
+    free(kinds);
+    
+    char path[4096];
+    int result = 0;
+    if(ht_path_join(path, sizeof(path), output_dir, "%s.hebt", name))
+    {
+        result = ht_write_file(path, output.data, output.len);
+    }
+    free(output.data);
+    
+    return result;
+}
+
+static int ht_encode_file(const char *input_file)
+{
+    char name[4096];
+    ht_strip_extension(name, sizeof(name), ht_basename(input_file));
+    
+    HTImageSequence sequence;
+    if(!ht_image_load(input_file, &sequence))
+    {
+        fprintf(stderr, "hebtool: cannot load %s\n", input_file);
+        return 0;
+    }
+    
+    int result;
+    
+    if(sequence.isGIF && sequence.length > 1)
+    {
+        HTBuffer *images = malloc(sizeof(HTBuffer) * sequence.length);
+        for(int i = 0; i < sequence.length; i++)
+        {
+            images[i] = ht_encode_image(&sequence.frames[i]);
+        }
+        
+        result = ht_save_table(name, images, sequence.length);
+        
+        for(int i = 0; i < sequence.length; i++)
+        {
+            free(images[i].data);
+            free(images[i].raw);
+            free(images[i].planes);
+        }
+        free(images);
+    }
+    else
+    {
+        HTBuffer image = ht_encode_image(&sequence.frames[0]);
+        
+        char path[4096];
+        result = 0;
+        if(ht_path_join(path, sizeof(path), output_dir, "%s.heb", name))
+        {
+            result = ht_write_file(path, image.data, image.len);
+        }
+        free(image.data);
+        free(image.raw);
+        free(image.planes);
+    }
+    
+    ht_image_sequence_free(&sequence);
+    
+    return result;
+}
+
+// Matches (.+)-table-([0-9]+)$
+static int ht_match_table_file(const char *name, HTTableFile *file)
+{
+    const char *pattern = "-table-";
+    const char *match = NULL;
+    const char *search = name;
+    const char *found;
+    
+    while((found = strstr(search, pattern)))
+    {
+        match = found;
+        search = found + 1;
+    }
+    
+    if(!match || match == name)
+    {
+        return 0;
+    }
+    
+    const char *digits = match + strlen(pattern);
+    if(*digits == '\0')
+    {
+        return 0;
+    }
+    for(const char *c = digits; *c; c++)
+    {
+        if(*c < '0' || *c > '9')
+        {
+            return 0;
+        }
+    }
+    
+    file->index = atoi(digits);
+    file->name = strndup(name, match - name);
+    
+    return 1;
+}
+
+static int ht_compare_table_files(const void *a, const void *b)
+{
+    const HTTableFile *file_a = a;
+    const HTTableFile *file_b = b;
+    return (file_a->index > file_b->index) - (file_a->index < file_b->index);
+}
+
+static int ht_encode_dir(const char *input_dir)
+{
+    DIR *dir = opendir(input_dir);
+    if(!dir)
+    {
+        fprintf(stderr, "hebtool: cannot open %s\n", input_dir);
+        return 0;
+    }
+    
+    HTTableFile *files = NULL;
+    int length = 0;
+    int result = 1;
+    
+    struct dirent *entry;
+    while(result && (entry = readdir(dir)))
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+        
+        char name[4096];
+        ht_strip_extension(name, sizeof(name), entry->d_name);
+        
+        HTTableFile file;
+        if(ht_match_table_file(name, &file))
+        {
+            char path[4096];
+            if(!ht_path_join(path, sizeof(path), input_dir, "%s", entry->d_name))
+            {
+                free(file.name);
+                result = 0;
+                break;
+            }
+            file.path = strdup(path);
+            
+            files = realloc(files, sizeof(HTTableFile) * (length + 1));
+            files[length++] = file;
+        }
+    }
+    closedir(dir);
+    
+    if(result && length > 0)
+    {
+        qsort(files, length, sizeof(HTTableFile), ht_compare_table_files);
+        
+        HTBuffer *images = calloc(length, sizeof(HTBuffer));
+        
+        for(int i = 0; i < length && result; i++)
+        {
+            HTImageSequence sequence;
+            if(!ht_image_load(files[i].path, &sequence))
+            {
+                fprintf(stderr, "hebtool: cannot load %s\n", files[i].path);
+                result = 0;
+                break;
+            }
+            images[i] = ht_encode_image(&sequence.frames[0]);
+            ht_image_sequence_free(&sequence);
+        }
+        
+        if(result)
+        {
+            result = ht_save_table(files[0].name, images, length);
+        }
+        
+        for(int i = 0; i < length; i++)
+        {
+            free(images[i].data);
+            free(images[i].raw);
+            free(images[i].planes);
+        }
+        free(images);
+    }
+    
+    for(int i = 0; i < length; i++)
+    {
+        free(files[i].name);
+        free(files[i].path);
+    }
+    free(files);
+    
+    return result;
+}
+
+//
+// Decoder
+//
+static uint8_t* ht_read_file(const char *filename, size_t *len)
+{
+    FILE *file = fopen(filename, "rb");
+    if(!file)
+    {
+        return NULL;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    long file_len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    uint8_t *data = malloc(file_len + 1);
+    if(data && fread(data, 1, file_len, file) != (size_t)file_len)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    
+    *len = file_len;
+    return data;
+}
+
+static int ht_decode_planes(const uint8_t *src, const uint8_t *end, const uint8_t *dictionary, size_t dictionary_size, HTPlanes *planes)
+{
+    if((end - src) < (8 * 4 + 1))
+    {
+        return 0;
+    }
+    
+    HEFormatBitmapHeader *header = &planes->header;
+    header->version = he_format_read_uint32(src);
+    header->width = he_format_read_uint32(src + 4);
+    header->height = he_format_read_uint32(src + 8);
+    header->bx = he_format_read_uint32(src + 12);
+    header->by = he_format_read_uint32(src + 16);
+    header->bw = he_format_read_uint32(src + 20);
+    header->bh = he_format_read_uint32(src + 24);
+    header->rowbytes = he_format_read_uint32(src + 28);
+    header->hasMask = src[32];
+    header->compressed = (header->version >= 3) ? src[33] : 0;
+    header->fill = (header->version >= 7 && header->hasMask) ? src[34] : HE_FORMAT_FILL_NONE;
+    
+    if(header->version > HE_FORMAT_VERSION || (size_t)(end - src) < he_format_bitmap_header_size(header->version) || (header->bx + header->bw) > header->width || (header->by + header->bh) > header->height)
+    {
+        return 0;
+    }
+    
+    const uint8_t *src_ptr = src + he_format_bitmap_header_size(header->version);
+    
+    size_t plane_size = (size_t)header->rowbytes * header->bh;
+    int planes_count = header->hasMask ? 2 : 1;
+    uint8_t *plane_data[2] = {NULL, NULL};
+    
+    int first_plane = 0;
+    if(header->fill != HE_FORMAT_FILL_NONE)
+    {
+        // Mask only, filled after the mask is read
+        plane_data[0] = malloc(plane_size + 1);
+        first_plane = 1;
+    }
+    
+    for(int i = first_plane; i < planes_count; i++)
+    {
+        plane_data[i] = malloc(plane_size + 1);
+        
+        size_t available = end - src_ptr;
+        size_t plane_len = plane_size;
+        if(header->compressed == HE_FORMAT_COMPRESSION_LZ)
+        {
+            plane_len = he_format_lz_decompress(plane_data[i], plane_size, src_ptr, available, dictionary, dictionary_size);
+        }
+        else if(header->compressed)
+        {
+            plane_len = he_format_decompress(plane_data[i], plane_size, src_ptr, available);
+        }
+        else if(plane_size <= available)
+        {
+            memcpy(plane_data[i], src_ptr, plane_size);
+        }
+        
+        if(plane_len > available)
+        {
+            // Truncated plane
+            free(plane_data[0]);
+            free(plane_data[1]);
+            return 0;
+        }
+        src_ptr += plane_len;
+    }
+    
+    if(header->fill != HE_FORMAT_FILL_NONE)
+    {
+        // Visible pixels have the fill color
+        if(header->fill == HE_FORMAT_FILL_WHITE)
+        {
+            memcpy(plane_data[0], plane_data[1], plane_size);
+        }
+        else
+        {
+            memset(plane_data[0], 0x00, plane_size);
+        }
+    }
+    
+    planes->data = plane_data[0];
+    planes->mask = plane_data[1];
+    
+    return 1;
+}
+
+static int ht_apply_delta(const uint8_t *src, const uint8_t *end, uint32_t size, HTPlanes *planes)
+{
+    // Changed word runs from the previous frame
+    if(size < 4 || (end - src) < size || planes->mask)
+    {
+        return 0;
+    }
+    
+    size_t plane_size = (size_t)planes->header.rowbytes * planes->header.bh;
+    
+    uint32_t runs_count = he_format_read_uint32(src);
+    const uint8_t *src_ptr = src + 4;
+    const uint8_t *src_end = src + size;
+    
+    for(uint32_t i = 0; i < runs_count; i++)
+    {
+        if((src_end - src_ptr) < 8)
+        {
+            return 0;
+        }
+        uint32_t offset = he_format_read_uint32(src_ptr);
+        uint32_t len = he_format_read_uint32(src_ptr + 4);
+        src_ptr += 8;
+        
+        if((src_end - src_ptr) < len || ((size_t)offset + len) > plane_size)
+        {
+            return 0;
+        }
+        memcpy(planes->data + offset, src_ptr, len);
+        src_ptr += len;
+    }
+    
+    return 1;
+}
+
+static HTPlanes ht_planes_copy(const HTPlanes *planes)
+{
+    HTPlanes copy = *planes;
+    size_t plane_size = (size_t)planes->header.rowbytes * planes->header.bh;
+    
+    copy.data = malloc(plane_size + 1);
+    memcpy(copy.data, planes->data, plane_size);
+    if(planes->mask)
+    {
+        copy.mask = malloc(plane_size + 1);
+        memcpy(copy.mask, planes->mask, plane_size);
+    }
+    
+    return copy;
+}
+
+static void ht_planes_free(HTPlanes *planes)
+{
+    free(planes->data);
+    free(planes->mask);
+    planes->data = NULL;
+    planes->mask = NULL;
+}
+
+static void ht_planes_to_image(const HTPlanes *planes, HTImage *image)
+{
+    const HEFormatBitmapHeader *header = &planes->header;
+    
+    image->width = header->width;
+    image->height = header->height;
+    image->rgba = calloc((size_t)header->width * header->height * 4, 1);
+    
+    for(uint32_t y = 0; y < header->bh; y++)
+    {
+        for(uint32_t x = 0; x < header->bw; x++)
+        {
+            size_t i = (size_t)y * header->rowbytes + x / 8;
+            uint8_t bit = 1 << (7 - (x % 8));
+            
+            uint8_t *pixel = image->rgba + ((size_t)(header->by + y) * header->width + (header->bx + x)) * 4;
+            uint8_t color = (planes->data[i] & bit) ? 0xFF : 0x00;
+            int opaque = planes->mask ? (planes->mask[i] & bit) : 1;
+            
+            pixel[0] = color;
+            pixel[1] = color;
+            pixel[2] = color;
+            pixel[3] = opaque ? 0xFF : 0x00;
+        }
+    }
+}
+
+static int ht_write_planes(const HTPlanes *planes, const char *path)
+{
+    HTImage image;
+    ht_planes_to_image(planes, &image);
+    int result = ht_image_write_png(path, &image);
+    free(image.rgba);
+    return result;
+}
+
+static int ht_decode_file(const char *input_file)
+{
+    char name[4096];
+    ht_strip_extension(name, sizeof(name), ht_basename(input_file));
+    
+    size_t len;
+    uint8_t *data = ht_read_file(input_file, &len);
+    if(!data)
+    {
+        fprintf(stderr, "hebtool: cannot read %s\n", input_file);
+        return 0;
+    }
+    
+    const uint8_t *end = data + len;
+    int result = 1;
+    
+    const char *extension = strrchr(input_file, '.');
+    
+    if(extension && strcmp(extension, ".hebt") == 0)
+    {
+        // Table: name/name-table-1.png, name-table-2.png, ...
+        uint32_t version = (len >= 8) ? he_format_read_uint32(data) : 0;
+        uint32_t length = (len >= 8) ? he_format_read_uint32(data + 4) : 0;
+        int table_compressed = (version >= 3 && len > 8) ? data[8] : 0;
+        
+        size_t frames_position = he_format_table_header_size(version, table_compressed) + he_format_table_index_size(version, length);
+        if(len < 8 || len < frames_position)
+        {
+            fprintf(stderr, "hebtool: cannot decode %s\n", input_file);
+            free(data);
+            return 0;
+        }
+        
+        uint32_t dictionary_size = 0;
+        if(version >= 9 && table_compressed == HE_FORMAT_COMPRESSION_LZ)
+        {
+            // Version 9 supports dictionary, after the allocator length
+            dictionary_size = he_format_read_uint32(data + 13);
+        }
+        
+        // Existing folders are not overwritten: name-2, name-3, ...
+        char table_dir[4096];
+        result = ht_path_join(table_dir, sizeof(table_dir), output_dir, "%s", name);
+        
+        struct stat dir_stat;
+        for(int i = 2; result && stat(table_dir, &dir_stat) == 0; i++)
+        {
+            result = ht_path_join(table_dir, sizeof(table_dir), output_dir, "%s-%d", name, i);
+        }
+        if(result)
+        {
+            mkdir(table_dir, 0755);
+        }
+        
+        // Frames are read in order, the index is skipped
+        const uint8_t *src_ptr = data + frames_position;
+        
+        // Version 9: the dictionary follows the index
+        uint8_t *dictionary = malloc(dictionary_size + 1);
+        size_t dictionary_len = he_format_lz_decompress(dictionary, dictionary_size, src_ptr, end - src_ptr, NULL, 0);
+        if(dictionary_len > (size_t)(end - src_ptr))
+        {
+            result = 0;
+            length = 0;
+        }
+        else
+        {
+            src_ptr += dictionary_len;
+        }
+        
+        const uint8_t **frames = calloc(length + 1, sizeof(uint8_t*));
+        
+        HTPlanes previous = {0};
+        
+        for(uint32_t i = 0; i < length && result; i++)
+        {
+            if((end - src_ptr) < 4)
+            {
+                result = 0;
+                break;
+            }
+            uint32_t size = he_format_read_uint32(src_ptr);
+            src_ptr += 4;
+            
+            HTPlanes planes = {0};
+            
+            if(size & HE_FORMAT_FRAME_DELTA)
+            {
+                size &= HE_FORMAT_FRAME_SIZE_MASK;
+                if(i == 0)
+                {
+                    result = 0;
+                    break;
+                }
+                planes = ht_planes_copy(&previous);
+                result = ht_apply_delta(src_ptr, end, size, &planes);
+            }
+            else
+            {
+                const uint8_t *frame_ptr = src_ptr;
+                if(size & HE_FORMAT_FRAME_REFERENCE)
+                {
+                    uint32_t index = size & HE_FORMAT_FRAME_SIZE_MASK;
+                    if(index >= i || !frames[index])
+                    {
+                        result = 0;
+                        break;
+                    }
+                    frame_ptr = frames[index];
+                    size = 0;
+                }
+                else
+                {
+                    frames[i] = frame_ptr;
+                }
+                result = ht_decode_planes(frame_ptr, end, dictionary, dictionary_size, &planes);
+            }
+            src_ptr += size;
+            
+            if(result)
+            {
+                char path[4096];
+                result = ht_path_join(path, sizeof(path), table_dir, "%s-table-%u.png", name, i + 1);
+                if(result)
+                {
+                    result = ht_write_planes(&planes, path);
+                }
+            }
+            
+            ht_planes_free(&previous);
+            previous = planes;
+        }
+        
+        ht_planes_free(&previous);
+        free(frames);
+        free(dictionary);
+    }
+    else
+    {
+        HTPlanes planes = {0};
+        if(ht_decode_planes(data, end, NULL, 0, &planes))
+        {
+            char path[4096];
+            result = ht_path_join(path, sizeof(path), output_dir, "%s.png", name);
+            if(result)
+            {
+                result = ht_write_planes(&planes, path);
+            }
+            ht_planes_free(&planes);
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    
+    if(!result)
+    {
+        fprintf(stderr, "hebtool: cannot decode %s\n", input_file);
+    }
+    
+    free(data);
+    
+    return result;
+}
+
+static void ht_usage(void)
+{
+    fprintf(stderr,
+            "usage: hebtool -i <file_or_folder> [-r] [--lz] [--delta] [-d]\n"
+            "  -i, --input   input file or folder (name-table-1.png, name-table-2.png, ...)\n"
+            "  -r, --raw     save as raw data (no compression)\n"
+            "      --lz      compress with LZ sequences, table frames share a dictionary\n"
+            "      --delta   save opaque table frames as changed words from the previous frame\n"
+            "  -d, --decode  decode a heb/hebt file to PNG\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *input_arg = NULL;
+    int decode = 0;
+    
+    for(int i = 1; i < argc; i++)
+    {
+        if((strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--input") == 0) && (i + 1) < argc)
+        {
+            input_arg = argv[++i];
+        }
+        else if(strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--raw") == 0)
+        {
+            compressed = HE_FORMAT_COMPRESSION_NONE;
+        }
+        else if(strcmp(argv[i], "--lz") == 0)
+        {
+            lz = 1;
+        }
+        else if(strcmp(argv[i], "--delta") == 0)
+        {
+            delta = 1;
+        }
+        else if(strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--decode") == 0)
+        {
+            decode = 1;
+        }
+        else
+        {
+            ht_usage();
+            return 2;
+        }
+    }
+    
+    if(lz && compressed)
+    {
+        // Raw data wins over --lz, like encoder.py
+        compressed = HE_FORMAT_COMPRESSION_LZ;
+    }
+    
+    if(!input_arg)
+    {
+        ht_usage();
+        return 2;
+    }
+    
+    char working_dir[4096];
+    if(!getcwd(working_dir, sizeof(working_dir)))
+    {
+        return 1;
+    }
+    
+    char input_file[4096];
+    snprintf(output_dir, sizeof(output_dir), "%s", working_dir);
+    
+    if(input_arg[0] == '/')
+    {
+        // Absolute input: save next to the input
+        snprintf(input_file, sizeof(input_file), "%s", input_arg);
+        snprintf(output_dir, sizeof(output_dir), "%s", input_arg);
+        char *slash = strrchr(output_dir, '/');
+        if(slash == output_dir)
+        {
+            slash[1] = '\0';
+        }
+        else
+        {
+            *slash = '\0';
+        }
+    }
+    else
+    {
+        if(!ht_path_join(input_file, sizeof(input_file), working_dir, "%s", input_arg))
+        {
+            return 1;
+        }
+    }
+    
+    struct stat input_stat;
+    if(stat(input_file, &input_stat) != 0)
+    {
+        fprintf(stderr, "hebtool: %s not found\n", input_arg);
+        return 1;
+    }
+    
+    int result;
+    
+    if(decode)
+    {
+        result = ht_decode_file(input_file);
+    }
+    else if(S_ISDIR(input_stat.st_mode))
+    {
+        // Trailing slashes are not part of the folder name
+        size_t len = strlen(input_file);
+        while(len > 1 && input_file[len - 1] == '/')
+        {
+            input_file[--len] = '\0';
+        }
+        result = ht_encode_dir(input_file);
+    }
+    else
+    {
+        result = ht_encode_file(input_file);
+    }
+    
+    return result ? 0 : 1;
+}
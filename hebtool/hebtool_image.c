@@ -0,0 +1,687 @@
+//
+//  hebtool_image.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <png.h>
+
+#include "hebtool_image.h"
+
+//
+// PNG
+//
+static int ht_png_load(FILE *file, HTImageSequence *sequence)
+{
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png)
+    {
+        return 0;
+    }
+    
+    png_infop info = png_create_info_struct(png);
+    if(!info)
+    {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return 0;
+    }
+    
+    uint8_t *rgba = NULL;
+    png_bytep *rows = NULL;
+    
+    if(setjmp(png_jmpbuf(png)))
+    {
+        free(rgba);
+        free(rows);
+        png_destroy_read_struct(&png, &info, NULL);
+        return 0;
+    }
+    
+    png_init_io(png, file);
+    png_read_info(png, info);
+    
+    int width = png_get_image_width(png, info);
+    int height = png_get_image_height(png, info);
+    int color_type = png_get_color_type(png, info);
+    int bit_depth = png_get_bit_depth(png, info);
+    
+    // Same conversion as Pillow's convert("RGBA"), no gamma correction
+    if(bit_depth == 16)
+    {
+        png_set_strip_16(png);
+    }
+    if(color_type == PNG_COLOR_TYPE_PALETTE)
+    {
+        png_set_palette_to_rgb(png);
+    }
+    if(color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8)
+    {
+        png_set_expand_gray_1_2_4_to_8(png);
+    }
+    if(png_get_valid(png, info, PNG_INFO_tRNS))
+    {
+        png_set_tRNS_to_alpha(png);
+    }
+    if(color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+    {
+        png_set_gray_to_rgb(png);
+    }
+    if(!(color_type & PNG_COLOR_MASK_ALPHA) && !png_get_valid(png, info, PNG_INFO_tRNS))
+    {
+        png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+    }
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+    
+    rgba = malloc((size_t)width * height * 4);
+    rows = malloc(sizeof(png_bytep) * height);
+    if(!rgba || !rows)
+    {
+        png_error(png, "cannot allocate data");
+    }
+    
+    for(int y = 0; y < height; y++)
+    {
+        rows[y] = rgba + (size_t)y * width * 4;
+    }
+    
+    png_read_image(png, rows);
+    png_read_end(png, NULL);
+    
+    free(rows);
+    png_destroy_read_struct(&png, &info, NULL);
+    
+    sequence->frames = malloc(sizeof(HTImage));
+    sequence->frames[0] = (HTImage){
+        .width = width,
+        .height = height,
+        .rgba = rgba
+    };
+    sequence->length = 1;
+    sequence->isGIF = 0;
+    
+    return 1;
+}
+
+int ht_image_write_png(const char *filename, const HTImage *image)
+{
+    FILE *file = fopen(filename, "wb");
+    if(!file)
+    {
+        return 0;
+    }
+    
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    if(!png || !info)
+    {
+        png_destroy_write_struct(&png, NULL);
+        fclose(file);
+        return 0;
+    }
+    
+    if(setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_write_struct(&png, &info);
+        fclose(file);
+        return 0;
+    }
+    
+    png_init_io(png, file);
+    png_set_IHDR(png, info, image->width, image->height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    
+    for(int y = 0; y < image->height; y++)
+    {
+        png_write_row(png, image->rgba + (size_t)y * image->width * 4);
+    }
+    
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+    fclose(file);
+    
+    return 1;
+}
+
+//
+// GIF
+//
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+} HTGIFReader;
+
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    int active;
+    uint8_t *rgba;
+} HTGIFDispose;
+
+static int gif_uint8(HTGIFReader *reader)
+{
+    if(reader->pos >= reader->len)
+    {
+        return -1;
+    }
+    return reader->data[reader->pos++];
+}
+
+static int gif_uint16(HTGIFReader *reader)
+{
+    int lo = gif_uint8(reader);
+    int hi = gif_uint8(reader);
+    if(lo < 0 || hi < 0)
+    {
+        return -1;
+    }
+    return lo | (hi << 8);
+}
+
+static void gif_skip_blocks(HTGIFReader *reader)
+{
+    int block_len;
+    while((block_len = gif_uint8(reader)) > 0)
+    {
+        reader->pos += block_len;
+    }
+}
+
+static int gif_lzw_decode(HTGIFReader *reader, int min_code_size, uint8_t *dst, size_t dst_len)
+{
+    if(min_code_size < 1 || min_code_size > 11)
+    {
+        return 0;
+    }
+    
+    static uint16_t prefix[4096];
+    static uint8_t suffix[4096];
+    static uint8_t stack[4097];
+    
+    int clear_code = 1 << min_code_size;
+    int end_code = clear_code + 1;
+    int code_size = min_code_size + 1;
+    int next_code = end_code + 1;
+    int prev_code = -1;
+    uint8_t first = 0;
+    
+    for(int i = 0; i < clear_code; i++)
+    {
+        prefix[i] = 0xFFFF;
+        suffix[i] = i;
+    }
+    
+    uint32_t bits = 0;
+    int bits_len = 0;
+    int block_len = 0;
+    size_t out = 0;
+    int done = 0;
+    
+    while(!done)
+    {
+        // Fill bits from the data sub-blocks
+        while(bits_len < code_size)
+        {
+            if(block_len == 0)
+            {
+                block_len = gif_uint8(reader);
+                if(block_len <= 0)
+                {
+                    done = 1;
+                    break;
+                }
+            }
+            int byte = gif_uint8(reader);
+            if(byte < 0)
+            {
+                done = 1;
+                break;
+            }
+            block_len--;
+            bits |= (uint32_t)byte << bits_len;
+            bits_len += 8;
+        }
+        
+        if(done)
+        {
+            break;
+        }
+        
+        int code = bits & ((1 << code_size) - 1);
+        bits >>= code_size;
+        bits_len -= code_size;
+        
+        if(code == clear_code)
+        {
+            code_size = min_code_size + 1;
+            next_code = end_code + 1;
+            prev_code = -1;
+            continue;
+        }
+        if(code == end_code)
+        {
+            break;
+        }
+        
+        int stack_len = 0;
+        int current = code;
+        
+        if(prev_code < 0)
+        {
+            if(code >= clear_code)
+            {
+                break;
+            }
+            first = suffix[code];
+            if(out < dst_len)
+            {
+                dst[out++] = first;
+            }
+            prev_code = code;
+            continue;
+        }
+        
+        if(code >= next_code)
+        {
+            // KwKwK case
+            stack[stack_len++] = first;
+            current = prev_code;
+        }
+        
+        while(current >= clear_code && stack_len < 4096)
+        {
+            stack[stack_len++] = suffix[current];
+            current = prefix[current];
+        }
+        stack[stack_len++] = suffix[current];
+        first = suffix[current];
+        
+        while(stack_len > 0)
+        {
+            uint8_t value = stack[--stack_len];
+            if(out < dst_len)
+            {
+                dst[out++] = value;
+            }
+        }
+        
+        if(next_code < 4096)
+        {
+            prefix[next_code] = prev_code;
+            suffix[next_code] = first;
+            next_code++;
+            if(next_code == (1 << code_size) && code_size < 12)
+            {
+                code_size++;
+            }
+        }
+        
+        prev_code = code;
+    }
+    
+    // Skip any remaining data
+    if(block_len > 0)
+    {
+        reader->pos += block_len;
+    }
+    if(block_len >= 0)
+    {
+        gif_skip_blocks(reader);
+    }
+    
+    return 1;
+}
+
+static void gif_deinterlace(uint8_t *pixels, int width, int height)
+{
+    uint8_t *copy = malloc((size_t)width * height);
+    memcpy(copy, pixels, (size_t)width * height);
+    
+    static const int starts[] = {0, 4, 2, 1};
+    static const int steps[] = {8, 8, 4, 2};
+    
+    int src_row = 0;
+    for(int pass = 0; pass < 4; pass++)
+    {
+        for(int y = starts[pass]; y < height; y += steps[pass])
+        {
+            memcpy(pixels + (size_t)y * width, copy + (size_t)src_row * width, width);
+            src_row++;
+        }
+    }
+    
+    free(copy);
+}
+
+static void gif_color(const uint8_t *palette, int palette_len, int index, uint8_t *rgb)
+{
+    if(!palette)
+    {
+        rgb[0] = rgb[1] = rgb[2] = index;
+        return;
+    }
+    if(index >= palette_len)
+    {
+        index = 0;
+    }
+    memcpy(rgb, palette + index * 3, 3);
+}
+
+//
+// Frames are composited like Pillow does (RGB after first frame):
+// the first frame is a palette image, later frames are pasted on top of the previous one
+//
+static int ht_gif_load(const uint8_t *data, size_t len, HTImageSequence *sequence)
+{
+    HTGIFReader reader = {
+        .data = data,
+        .len = len,
+        .pos = 6
+    };
+    
+    int width = gif_uint16(&reader);
+    int height = gif_uint16(&reader);
+    int flags = gif_uint8(&reader);
+    int background = gif_uint8(&reader);
+    gif_uint8(&reader); // aspect ratio
+    
+    if(width <= 0 || height <= 0 || flags < 0)
+    {
+        return 0;
+    }
+    
+    const uint8_t *global_palette = NULL;
+    int global_palette_len = 0;
+    if(flags & 0x80)
+    {
+        global_palette_len = 1 << ((flags & 7) + 1);
+        global_palette = data + reader.pos;
+        reader.pos += global_palette_len * 3;
+    }
+    
+    size_t canvas_size = (size_t)width * height * 4;
+    uint8_t *canvas = calloc(canvas_size, 1);
+    int canvas_alpha = 0;
+    int info_transparency = -1;
+    int disposal_method = 0;
+    
+    HTGIFDispose dispose = {0};
+    
+    sequence->frames = NULL;
+    sequence->length = 0;
+    sequence->isGIF = 1;
+    
+    int frame_transparency = -1;
+    int frame = 0;
+    
+    while(reader.pos < reader.len)
+    {
+        int block = gif_uint8(&reader);
+        
+        if(block == 0x21)
+        {
+            int label = gif_uint8(&reader);
+            int block_len = gif_uint8(&reader);
+            if(label == 0xF9 && block_len >= 4)
+            {
+                int gce_flags = data[reader.pos];
+                if(gce_flags & 1)
+                {
+                    frame_transparency = data[reader.pos + 3];
+                }
+                int dispose_bits = (gce_flags >> 2) & 7;
+                if(dispose_bits)
+                {
+                    disposal_method = dispose_bits;
+                }
+            }
+            if(block_len > 0)
+            {
+                reader.pos += block_len;
+                gif_skip_blocks(&reader);
+            }
+        }
+        else if(block == 0x2C)
+        {
+            int x0 = gif_uint16(&reader);
+            int y0 = gif_uint16(&reader);
+            int frame_width = gif_uint16(&reader);
+            int frame_height = gif_uint16(&reader);
+            int frame_flags = gif_uint8(&reader);
+            
+            const uint8_t *palette = global_palette;
+            int palette_len = global_palette_len;
+            if(frame_flags & 0x80)
+            {
+                palette_len = 1 << ((frame_flags & 7) + 1);
+                palette = data + reader.pos;
+                reader.pos += palette_len * 3;
+            }
+            
+            int min_code_size = gif_uint8(&reader);
+            
+            uint8_t *pixels = calloc((size_t)frame_width * frame_height + 1, 1);
+            if(!gif_lzw_decode(&reader, min_code_size, pixels, (size_t)frame_width * frame_height))
+            {
+                free(pixels);
+                break;
+            }
+            if(frame_flags & 0x40)
+            {
+                gif_deinterlace(pixels, frame_width, frame_height);
+            }
+            
+            int x1 = x0 + frame_width;
+            int y1 = y0 + frame_height;
+            
+            // Dispose of the previous frame
+            if(dispose.active)
+            {
+                for(int y = dispose.y0; y < dispose.y1 && y < height; y++)
+                {
+                    for(int x = dispose.x0; x < dispose.x1 && x < width; x++)
+                    {
+                        uint8_t *src = dispose.rgba + ((size_t)(y - dispose.y0) * (dispose.x1 - dispose.x0) + (x - dispose.x0)) * 4;
+                        uint8_t *dst = canvas + ((size_t)y * width + x) * 4;
+                        memcpy(dst, src, 4);
+                        if(!canvas_alpha)
+                        {
+                            dst[3] = 0xFF;
+                        }
+                    }
+                }
+                free(dispose.rgba);
+                dispose.active = 0;
+            }
+            
+            if(frame == 0)
+            {
+                // Palette image filled with the transparent color
+                int fill_index = (frame_transparency >= 0) ? frame_transparency : 0;
+                info_transparency = frame_transparency;
+                canvas_alpha = (frame_transparency >= 0);
+                
+                for(int y = 0; y < height; y++)
+                {
+                    for(int x = 0; x < width; x++)
+                    {
+                        int index = fill_index;
+                        if(x >= x0 && x < x1 && y >= y0 && y < y1)
+                        {
+                            index = pixels[(size_t)(y - y0) * frame_width + (x - x0)];
+                        }
+                        uint8_t *dst = canvas + ((size_t)y * width + x) * 4;
+                        gif_color(palette, palette_len, index, dst);
+                        dst[3] = (info_transparency >= 0 && index == info_transparency) ? 0x00 : 0xFF;
+                    }
+                }
+            }
+            
+            // Prepare the disposal of this frame
+            if(disposal_method >= 2)
+            {
+                int dispose_width = x1 - x0;
+                int dispose_height = y1 - y0;
+                
+                dispose = (HTGIFDispose){
+                    .x0 = x0,
+                    .y0 = y0,
+                    .x1 = x1,
+                    .y1 = y1,
+                    .active = 1,
+                    .rgba = malloc((size_t)dispose_width * dispose_height * 4 + 1)
+                };
+                
+                if(disposal_method == 2)
+                {
+                    uint8_t rgba[4];
+                    int color = (frame == 0 && info_transparency >= 0) ? info_transparency : frame_transparency;
+                    if(color >= 0)
+                    {
+                        gif_color(palette, palette_len, color, rgba);
+                        rgba[3] = 0x00;
+                    }
+                    else
+                    {
+                        gif_color(palette, palette_len, background, rgba);
+                        rgba[3] = (frame == 0 && info_transparency >= 0 && background == info_transparency) ? 0x00 : 0xFF;
+                    }
+                    for(int i = 0; i < dispose_width * dispose_height; i++)
+                    {
+                        memcpy(dispose.rgba + (size_t)i * 4, rgba, 4);
+                    }
+                }
+                else if(frame > 0)
+                {
+                    // Restore previous contents
+                    for(int y = y0; y < y1; y++)
+                    {
+                        for(int x = x0; x < x1; x++)
+                        {
+                            uint8_t *dst = dispose.rgba + ((size_t)(y - y0) * dispose_width + (x - x0)) * 4;
+                            if(x < width && y < height)
+                            {
+                                memcpy(dst, canvas + ((size_t)y * width + x) * 4, 4);
+                            }
+                        }
+                    }
+                }
+                else if(frame_transparency >= 0)
+                {
+                    uint8_t rgba[4];
+                    gif_color(palette, palette_len, frame_transparency, rgba);
+                    rgba[3] = 0x00;
+                    for(int i = 0; i < dispose_width * dispose_height; i++)
+                    {
+                        memcpy(dispose.rgba + (size_t)i * 4, rgba, 4);
+                    }
+                }
+                else
+                {
+                    free(dispose.rgba);
+                    dispose.active = 0;
+                }
+            }
+            
+            if(frame > 0)
+            {
+                // Paste the frame on top of the previous one
+                for(int y = y0; y < y1 && y < height; y++)
+                {
+                    for(int x = x0; x < x1 && x < width; x++)
+                    {
+                        int index = pixels[(size_t)(y - y0) * frame_width + (x - x0)];
+                        if(frame_transparency >= 0 && index == frame_transparency)
+                        {
+                            continue;
+                        }
+                        uint8_t *dst = canvas + ((size_t)y * width + x) * 4;
+                        gif_color(palette, palette_len, index, dst);
+                        dst[3] = 0xFF;
+                    }
+                }
+            }
+            
+            free(pixels);
+            
+            sequence->frames = realloc(sequence->frames, sizeof(HTImage) * (sequence->length + 1));
+            HTImage *image = &sequence->frames[sequence->length++];
+            image->width = width;
+            image->height = height;
+            image->rgba = malloc(canvas_size);
+            memcpy(image->rgba, canvas, canvas_size);
+            
+            frame_transparency = -1;
+            frame++;
+        }
+        else
+        {
+            // Trailer or unknown block
+            break;
+        }
+    }
+    
+    if(dispose.active)
+    {
+        free(dispose.rgba);
+    }
+    free(canvas);
+    
+    return sequence->length > 0;
+}
+
+int ht_image_load(const char *filename, HTImageSequence *sequence)
+{
+    FILE *file = fopen(filename, "rb");
+    if(!file)
+    {
+        return 0;
+    }
+    
+    uint8_t signature[8] = {0};
+    size_t signature_len = fread(signature, 1, sizeof(signature), file);
+    fseek(file, 0, SEEK_SET);
+    
+    int result = 0;
+    
+    if(signature_len == 8 && png_sig_cmp(signature, 0, 8) == 0)
+    {
+        result = ht_png_load(file, sequence);
+    }
+    else if(signature_len >= 6 && (memcmp(signature, "GIF87a", 6) == 0 || memcmp(signature, "GIF89a", 6) == 0))
+    {
+        fseek(file, 0, SEEK_END);
+        long len = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        
+        uint8_t *data = malloc(len);
+        if(data && fread(data, 1, len, file) == (size_t)len)
+        {
+            result = ht_gif_load(data, len, sequence);
+        }
+        free(data);
+    }
+    
+    fclose(file);
+    
+    return result;
+}
+
+void ht_image_sequence_free(HTImageSequence *sequence)
+{
+    for(int i = 0; i < sequence->length; i++)
+    {
+        free(sequence->frames[i].rgba);
+    }
+    free(sequence->frames);
+    sequence->frames = NULL;
+    sequence->length = 0;
+}
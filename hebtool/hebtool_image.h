@@ -0,0 +1,31 @@
+//
+//  hebtool_image.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef hebtool_image_h
+#define hebtool_image_h
+
+#include <stdint.h>
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t *rgba;
+} HTImage;
+
+typedef struct {
+    HTImage *frames;
+    int length;
+    int isGIF;
+} HTImageSequence;
+
+// Loads a PNG or GIF file as RGBA frames (one frame for PNG)
+int ht_image_load(const char *filename, HTImageSequence *sequence);
+void ht_image_sequence_free(HTImageSequence *sequence);
+
+int ht_image_write_png(const char *filename, const HTImage *image);
+
+#endif /* hebtool_image_h */
@@ -0,0 +1,160 @@
+//
+//  he_host.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <stdarg.h>
+#include <time.h>
+
+#include "he_host.h"
+
+static uint8_t he_host_frame[LCD_ROWS * LCD_ROWSIZE] __attribute__((aligned(4)));
+
+static struct timespec he_host_startTime;
+
+//
+// System
+//
+static void* he_host_realloc(void *ptr, size_t size)
+{
+    if(size == 0)
+    {
+        free(ptr);
+        return NULL;
+    }
+    return realloc(ptr, size);
+}
+
+static void he_host_logToConsole(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+static double he_host_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - he_host_startTime.tv_sec) + (now.tv_nsec - he_host_startTime.tv_nsec) / 1e9;
+}
+
+static unsigned int he_host_getCurrentTimeMilliseconds(void)
+{
+    return (unsigned int)(he_host_time() * 1000);
+}
+
+static float he_host_getElapsedTime(void)
+{
+    return (float)he_host_time();
+}
+
+//
+// File
+//
+static SDFile* he_host_open(const char *name, FileOptions mode)
+{
+    if(mode & (kFileWrite | kFileAppend))
+    {
+        // Read only
+        return NULL;
+    }
+    return fopen(name, "rb");
+}
+
+static int he_host_close(SDFile *file)
+{
+    return fclose(file);
+}
+
+static int he_host_read(SDFile *file, void *buf, unsigned int len)
+{
+    size_t read = fread(buf, 1, len, file);
+    return ferror((FILE*)file) ? -1 : (int)read;
+}
+
+static int he_host_seek(SDFile *file, int pos, int whence)
+{
+    return fseek(file, pos, whence);
+}
+
+static int he_host_tell(SDFile *file)
+{
+    return (int)ftell(file);
+}
+
+//
+// Graphics
+//
+static LCDBitmap* he_host_loadBitmap(const char *path, const char **outerr)
+{
+    (void)path;
+    if(outerr)
+    {
+        *outerr = "pdi images are not supported by host builds";
+    }
+    return NULL;
+}
+
+static LCDBitmapTable* he_host_loadBitmapTable(const char *path, const char **outerr)
+{
+    (void)path;
+    if(outerr)
+    {
+        *outerr = "pdt tables are not supported by host builds";
+    }
+    return NULL;
+}
+
+static uint8_t* he_host_getFrame(void)
+{
+    return he_host_frame;
+}
+
+static void he_host_markUpdatedRows(int start, int end)
+{
+    (void)start;
+    (void)end;
+}
+
+static const struct playdate_sys he_host_system = {
+    .realloc = he_host_realloc,
+    .logToConsole = he_host_logToConsole,
+    .getCurrentTimeMilliseconds = he_host_getCurrentTimeMilliseconds,
+    .getElapsedTime = he_host_getElapsedTime
+};
+
+static const struct playdate_file he_host_file = {
+    .open = he_host_open,
+    .close = he_host_close,
+    .read = he_host_read,
+    .seek = he_host_seek,
+    .tell = he_host_tell
+};
+
+// Bitmaps are never created, the other functions are not called
+static const struct playdate_graphics he_host_graphics = {
+    .loadBitmap = he_host_loadBitmap,
+    .loadBitmapTable = he_host_loadBitmapTable,
+    .getFrame = he_host_getFrame,
+    .markUpdatedRows = he_host_markUpdatedRows
+};
+
+static const PlaydateAPI he_host_playdate = {
+    .system = &he_host_system,
+    .file = &he_host_file,
+    .graphics = &he_host_graphics
+};
+
+PlaydateAPI* he_host_api(void)
+{
+    if(he_host_startTime.tv_sec == 0 && he_host_startTime.tv_nsec == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &he_host_startTime);
+    }
+    return (PlaydateAPI*)&he_host_playdate;
+}
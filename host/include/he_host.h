@@ -0,0 +1,17 @@
+//
+//  he_host.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef he_host_h
+#define he_host_h
+
+#include "pd_api.h"
+
+// Playdate API for host builds: libc allocator, stdio files and a display frame of LCD_ROWS * LCD_ROWSIZE bytes
+// pdi/pdt loaders are not available, use HEB/HEBT files or memory data
+PlaydateAPI* he_host_api(void);
+
+#endif /* he_host_h */
@@ -0,0 +1,79 @@
+//
+//  pd_api.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+// Subset of the Playdate C API used by the library, for host builds without the SDK
+// See he_host.h for the implementation
+
+#ifndef pd_api_h
+#define pd_api_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LCD_COLUMNS 400
+#define LCD_ROWS 240
+#define LCD_ROWSIZE 52
+
+typedef uint8_t LCDPattern[16];
+typedef uintptr_t LCDColor;
+
+typedef enum {
+    kColorBlack,
+    kColorWhite,
+    kColorClear,
+    kColorXOR
+} LCDSolidColor;
+
+typedef struct LCDBitmap LCDBitmap;
+typedef struct LCDBitmapTable LCDBitmapTable;
+
+typedef void SDFile;
+
+typedef enum {
+    kFileRead = (1 << 0),
+    kFileReadData = (1 << 1),
+    kFileWrite = (1 << 2),
+    kFileAppend = (2 << 2)
+} FileOptions;
+
+struct playdate_sys {
+    void* (*realloc)(void *ptr, size_t size);
+    void (*logToConsole)(const char *fmt, ...);
+    unsigned int (*getCurrentTimeMilliseconds)(void);
+    float (*getElapsedTime)(void);
+};
+
+struct playdate_file {
+    SDFile* (*open)(const char *name, FileOptions mode);
+    int (*close)(SDFile *file);
+    int (*read)(SDFile *file, void *buf, unsigned int len);
+    int (*seek)(SDFile *file, int pos, int whence);
+    int (*tell)(SDFile *file);
+};
+
+struct playdate_graphics {
+    LCDBitmap* (*loadBitmap)(const char *path, const char **outerr);
+    void (*freeBitmap)(LCDBitmap *bitmap);
+    void (*getBitmapData)(LCDBitmap *bitmap, int *width, int *height, int *rowbytes, uint8_t **mask, uint8_t **data);
+    LCDBitmapTable* (*loadBitmapTable)(const char *path, const char **outerr);
+    void (*freeBitmapTable)(LCDBitmapTable *table);
+    LCDBitmap* (*getTableBitmap)(LCDBitmapTable *table, int idx);
+    void (*getBitmapTableInfo)(LCDBitmapTable *table, int *count, int *width);
+    uint8_t* (*getFrame)(void);
+    void (*markUpdatedRows)(int start, int end);
+};
+
+typedef struct PlaydateAPI {
+    const struct playdate_sys *system;
+    const struct playdate_file *file;
+    const struct playdate_graphics *graphics;
+} PlaydateAPI;
+
+#endif /* pd_api_h */
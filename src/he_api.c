@@ -38,14 +38,12 @@ void he_graphics_popContext(void)
 
 void he_graphics_setClipRect(int x, int y, int width, int height)
 {
-    he_graphics_context->_clipRect = he_rect_new(x, y, width, height);
-    he_graphics_context->clipRect = he_rect_intersection(he_gfx_screenRect, he_graphics_context->_clipRect);
+    HEGraphicsContext_setClipRect(he_graphics_context, x, y, width, height);
 }
 
 void he_graphics_clearClipRect(void)
 {
-    he_graphics_context->_clipRect = he_gfx_screenRect;
-    he_graphics_context->clipRect = he_graphics_context->_clipRect;
+    HEGraphicsContext_clearClipRect(he_graphics_context);
 }
 
 HERect he_graphics_getClipRect(void)
@@ -53,9 +51,103 @@ HERect he_graphics_getClipRect(void)
     return he_graphics_context->_clipRect;
 }
 
+HEGraphicsContext* he_graphics_getContext(void)
+{
+    return he_graphics_context;
+}
+
+//
+// Graphics context
+//
+HEGraphicsContext* HEGraphicsContext_new(uint8_t *frame)
+{
+    return HEGraphicsContext_newWithSize(frame, LCD_COLUMNS, LCD_ROWS, LCD_ROWSIZE);
+}
+
+HEGraphicsContext* HEGraphicsContext_newWithSize(uint8_t *frame, int width, int height, int rowbytes)
+{
+    if(width < 0 || height < 0 || rowbytes % 4 != 0 || rowbytes < ((width + 31) / 32 * 4) || (!frame && (width != LCD_COLUMNS || height != LCD_ROWS || rowbytes != LCD_ROWSIZE)))
+    {
+        playdate->system->logToConsole("HEGraphicsContext: invalid frame %ix%i, %i bytes per row", width, height, rowbytes);
+        return NULL;
+    }
+    
+    HEGraphicsContext *context = playdate->system->realloc(NULL, sizeof(HEGraphicsContext));
+    if(!context)
+    {
+        playdate->system->logToConsole("HEGraphicsContext: cannot allocate context");
+        return NULL;
+    }
+    he_memory_alloc(HEMemoryMetadata, sizeof(HEGraphicsContext));
+    
+    *context = he_graphics_context_new(frame, width, height, rowbytes);
+    
+    return context;
+}
+
+void HEGraphicsContext_setClipRect(HEGraphicsContext *context, int x, int y, int width, int height)
+{
+    context->_clipRect = he_rect_new(x, y, width, height);
+    context->clipRect = he_rect_intersection(he_rect_new(0, 0, context->width, context->height), context->_clipRect);
+}
+
+void HEGraphicsContext_clearClipRect(HEGraphicsContext *context)
+{
+    context->_clipRect = he_rect_new(0, 0, context->width, context->height);
+    context->clipRect = context->_clipRect;
+}
+
+HERect HEGraphicsContext_getClipRect(HEGraphicsContext *context)
+{
+    return context->_clipRect;
+}
+
+void HEGraphicsContext_free(HEGraphicsContext *context)
+{
+    playdate->system->realloc(context, 0);
+    he_memory_free(HEMemoryMetadata, sizeof(HEGraphicsContext));
+}
+
+//
+// Stats
+//
+HEStats he_stats_get(void)
+{
+    return he_stats;
+}
+
+void he_stats_reset(void)
+{
+    he_stats = (HEStats){0};
+}
+
+//
+// Memory
+//
+HEMemoryStats he_memory_get(void)
+{
+    return he_memory;
+}
+
+void he_memory_resetPeak(void)
+{
+    he_memory.planes.peak = he_memory.planes.live;
+    he_memory.rawBuffers.peak = he_memory.rawBuffers.live;
+    he_memory.metadata.peak = he_memory.metadata.live;
+    he_memory.total.peak = he_memory.total.live;
+}
+
 // Forward declarations
 void he_bitmap_init(PlaydateAPI *pd);
 void he_prv_init(PlaydateAPI *pd);
+void he_graphics_init(PlaydateAPI *pd);
+void he_drawlist_init(PlaydateAPI *pd);
+void he_font_init(PlaydateAPI *pd);
+void he_cache_init(PlaydateAPI *pd);
+void he_particles_init(PlaydateAPI *pd);
+#if HE_LUA
+void he_lua_init(PlaydateAPI *pd);
+#endif
 
 void he_library_init(PlaydateAPI *pd)
 {
@@ -63,14 +155,21 @@ void he_library_init(PlaydateAPI *pd)
     
     gfx_stack_index = 0;
     
-    gfx_stack[gfx_stack_index] = (HEGraphicsContext){
-        ._clipRect = he_gfx_screenRect,
-        .clipRect = he_gfx_screenRect
-    };
+    gfx_stack[gfx_stack_index] = he_graphics_context_new(NULL, LCD_COLUMNS, LCD_ROWS, LCD_ROWSIZE);
     he_graphics_context = &gfx_stack[gfx_stack_index];
     
     he_graphics_clearClipRect();
     
+    he_stats_reset();
+    
     he_prv_init(pd);
     he_bitmap_init(pd);
+    he_graphics_init(pd);
+    he_drawlist_init(pd);
+    he_font_init(pd);
+    he_cache_init(pd);
+    he_particles_init(pd);
+#if HE_LUA
+    he_lua_init(pd);
+#endif
 }
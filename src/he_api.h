@@ -12,9 +12,31 @@
 #define HE_GFX_STACK_SIZE 1024
 #endif
 
+#ifndef HE_READER_CHUNK_SIZE
+#define HE_READER_CHUNK_SIZE 1024
+#endif
+
+#ifndef HE_STATS
+#define HE_STATS 0
+#endif
+
+// Lua bindings (disabled by host builds)
+#ifndef HE_LUA
+#define HE_LUA 1
+#endif
+
+// Rows of a draw list coverage tile
+#ifndef HE_DRAWLIST_TILE_HEIGHT
+#define HE_DRAWLIST_TILE_HEIGHT 8
+#endif
+
 #include "pd_api.h"
 #include "he_foundation.h"
 #include "he_bitmap.h"
+#include "he_drawlist.h"
+#include "he_font.h"
+#include "he_cache.h"
+#include "he_particles.h"
 
 void he_library_init(PlaydateAPI *pd);
 
@@ -26,5 +48,80 @@ void he_graphics_popContext(void);
 void he_graphics_setClipRect(int x, int y, int width, int height);
 void he_graphics_clearClipRect(void);
 HERect he_graphics_getClipRect(void);
+// Color is a solid color or an 8x8 pattern (LCDPattern)
+void he_graphics_fillRect(int x, int y, int width, int height, LCDColor color);
+void he_graphics_fillHLine(int x, int y, int width, LCDColor color);
+void he_graphics_fillVLine(int x, int y, int height, LCDColor color);
+// Moves the pixels in the clip rect by dx, dy, the exposed pixels are not cleared
+void he_graphics_scroll(int dx, int dy);
+// Exposed parts of the clip rect after a scroll (up to 2 rects), redraw them with their clip rect
+int he_graphics_getScrollStrips(int dx, int dy, HERect strips[2]);
+// Context used by the draw functions without a context (top of the stack)
+HEGraphicsContext* he_graphics_getContext(void);
+
+//
+// Graphics context (draw targets for the *InContext functions)
+//
+// frame is LCD_ROWS * LCD_ROWSIZE bytes, NULL for the display frame
+HEGraphicsContext* HEGraphicsContext_new(uint8_t *frame);
+// 1-bit frame of any size, rowbytes is a multiple of 4 (4-byte aligned frame)
+HEGraphicsContext* HEGraphicsContext_newWithSize(uint8_t *frame, int width, int height, int rowbytes);
+void HEGraphicsContext_setClipRect(HEGraphicsContext *context, int x, int y, int width, int height);
+void HEGraphicsContext_clearClipRect(HEGraphicsContext *context);
+HERect HEGraphicsContext_getClipRect(HEGraphicsContext *context);
+void HEGraphicsContext_fillRect(HEGraphicsContext *context, int x, int y, int width, int height, LCDColor color);
+void HEGraphicsContext_fillHLine(HEGraphicsContext *context, int x, int y, int width, LCDColor color);
+void HEGraphicsContext_fillVLine(HEGraphicsContext *context, int x, int y, int height, LCDColor color);
+void HEGraphicsContext_scroll(HEGraphicsContext *context, int dx, int dy);
+int HEGraphicsContext_getScrollStrips(HEGraphicsContext *context, int dx, int dy, HERect strips[2]);
+void HEGraphicsContext_free(HEGraphicsContext *context);
+
+//
+// Lua (call on kEventInitLua, see Source/hebitmap.lua)
+//
+#if HE_LUA
+int he_lua_register(void);
+#endif
+
+//
+// Stats (requires HE_STATS=1)
+//
+typedef struct {
+    unsigned int drawCalls;
+    unsigned int culledDraws;
+    unsigned int clippedDraws;
+    unsigned int opaqueDraws;
+    unsigned int maskDraws;
+    unsigned int fillDraws;
+    unsigned int occludedDraws;
+    unsigned int rows;
+    unsigned int words;
+    float kernelTime;
+} HEStats;
+
+HEStats he_stats_get(void);
+void he_stats_reset(void);
+
+//
+// Memory (heap used by bitmaps and tables)
+//
+typedef struct {
+    size_t live;
+    size_t peak;
+} HEMemoryCounter;
+
+typedef struct {
+    // Pixel planes, allocator data, delta runs and playback buffers
+    HEMemoryCounter planes;
+    // File buffers used in place by raw bitmaps
+    HEMemoryCounter rawBuffers;
+    // Structs, frame indexes and reader chunks
+    HEMemoryCounter metadata;
+    HEMemoryCounter total;
+} HEMemoryStats;
+
+HEMemoryStats he_memory_get(void);
+// Peaks restart from the live values
+void he_memory_resetPeak(void);
 
 #endif /* he_api_h */
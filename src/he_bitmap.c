@@ -5,25 +5,54 @@
 //  Created by Matteo D'Ignazio on 11/06/24.
 //
 
+#include <limits.h>
+
 #include "he_bitmap.h"
 #include "he_api.h"
 #include "he_prv.h"
+#include "he_format.h"
 
 #include "he_bitmap_draw.h" // Opaque
 #define HE_BITMAP_MASK
 #include "he_bitmap_draw.h" // Mask
+#define HE_BITMAP_FILL
+#include "he_bitmap_draw.h" // Fill
+#undef HE_BITMAP_FILL
 #undef HE_BITMAP_MASK
 
 static PlaydateAPI *playdate;
 
-static HEBitmap* HEBitmap_fromBuffer(uint8_t *buffer, int isOwner, int *retainBuffer, _HEBitmapAllocator *allocator, int useAllocator);
+static HEBitmap* HEBitmap_fromReader(_HEReader *reader, int isOwner, int *retainBuffer, _HEBitmapAllocator *allocator, int useAllocator);
+static int HEBitmap_validHeader(HEBitmap *bitmap);
+static HEBitmap* HEBitmap_fromReaderFailed(HEBitmap *bitmap, int *retainBuffer);
+static void HEBitmap_eliminatePlanes(HEBitmap *bitmap);
+static size_t HEBitmap_planeSize(_HEBitmap *prv);
+
+static _HEReader HEReader_zero(void);
+static int HEReader_openFile(_HEReader *reader, const char *filename);
+static int HEReader_toBuffer(_HEReader *reader);
+static size_t HEReader_fileSize(_HEReader *reader);
+static void HEReader_close(_HEReader *reader);
+static uint8_t HEReader_uint8(_HEReader *reader);
+static uint32_t HEReader_uint32(_HEReader *reader);
+static void HEReader_skip(_HEReader *reader, size_t len);
+static size_t HEReader_tell(_HEReader *reader);
+static void HEReader_seek(_HEReader *reader, size_t position);
+static void HEReader_readData(_HEReader *reader, uint8_t *dst, size_t len, int compressed);
+
+static HEBitmapTableLoader* HEBitmapTableLoader_fromLCDBitmapTable(LCDBitmapTable *lcd_bitmapTable, int freeLCDBitmapTable);
+static HEBitmapTableLoader* HEBitmapTableLoader_fromReader(_HEReader reader, int staticBuffer, int useAllocator);
+static int HEBitmapTableLoader_readDictionary(HEBitmapTableLoader *loader, size_t dictionarySize);
+static uint32_t HEBitmapTableLoader_seekFrame(HEBitmapTableLoader *loader, unsigned int frame);
+static int HEBitmapTableLoader_nextDelta(HEBitmapTableLoader *loader, size_t delta_size);
+static int HEBitmapTableLoader_firstDelta(HEBitmapTableLoader *loader);
+static void HEBitmapTable_playback(HEBitmapTable *bitmapTable, unsigned int index);
+static void HEBitmapTable_drawDelta(HEBitmap *bitmap, _HEBitmapDelta *delta, int x, int y, HEGraphicsContext *context);
 
 static _HEBitmapAllocator HEBitmapAllocator_zero(void);
 static void HEBitmapAllocator_alloc_bitmaps(_HEBitmapAllocator *allocator, unsigned int length);
 static void HEBitmapAllocator_free(_HEBitmapAllocator *allocator);
 
-static uint8_t read_uint8(uint8_t **buffer_ptr);
-static uint32_t read_uint32(uint8_t **buffer_ptr);
 static void buffer_align_8_32(uint8_t *dst, uint8_t *src, int dst_cols, int src_cols, int x, int y, int width, int height, uint8_t fill_value);
 static void get_bounds(uint8_t *mask, int rowbytes, int width, int height, int *bx, int *by, int *bw, int *bh);
 static void allocation_failed(void);
@@ -42,6 +71,7 @@ HEBitmap* HEBitmap_base(_HEBitmapAllocator *allocator)
     else
     {
         bitmap = playdate->system->realloc(NULL, sizeof(HEBitmap));
+        he_memory_alloc(HEMemoryMetadata, sizeof(HEBitmap));
     }
     
     bitmap->width = 0;
@@ -50,11 +80,16 @@ HEBitmap* HEBitmap_base(_HEBitmapAllocator *allocator)
     _HEBitmap *prv = &bitmap->prv;
     
     prv->rawBuffer = NULL;
+    prv->rawBufferSize = 0;
     prv->hasMask = 0;
+    prv->hasFill = 0;
+    prv->fill = 0x00000000;
     prv->isOwner = 0;
+    prv->isShared = 0;
+    prv->sharedHash = 0;
     prv->freeData = 0;
     prv->freeSelf = allocator ? 0 : 1;
-
+    
     prv->bx = 0;
     prv->by = 0;
     prv->bw = 0;
@@ -115,6 +150,8 @@ HEBitmap* _HEBitmap_fromLCDBitmap(LCDBitmap *lcd_bitmap, int isOwner, _HEBitmapA
         }
     }
     
+    he_memory_alloc(HEMemoryPlanes, mask ? (data_size * 2) : data_size);
+    
     HEBitmap *bitmap = HEBitmap_base(allocator);
     
     bitmap->width = width;
@@ -131,16 +168,19 @@ HEBitmap* _HEBitmap_fromLCDBitmap(LCDBitmap *lcd_bitmap, int isOwner, _HEBitmapA
     prv->bh = bh;
     
     prv->rowbytes = rowbytes_aligned;
-
+    
     prv->data = data;
     buffer_align_8_32(prv->data, lcd_data, rowbytes_aligned, rowbytes, bx, by, bw, bh, 0x00);
-        
+    
     prv->mask = mask;
     if(prv->mask)
     {
         buffer_align_8_32(prv->mask, lcd_mask, rowbytes_aligned, rowbytes, bx, by, bw, bh, 0x00);
+        prv->hasMask = 1;
     }
     
+    HEBitmap_eliminatePlanes(bitmap);
+    
     return bitmap;
 }
 
@@ -149,111 +189,195 @@ HEBitmap* HEBitmap_fromLCDBitmap(LCDBitmap *lcd_bitmap)
     return _HEBitmap_fromLCDBitmap(lcd_bitmap, 1, NULL);
 }
 
+HEBitmap* _HEBitmap_fromPlanes(int width, int height, uint8_t *data, uint8_t *mask, int rowbytes)
+{
+    // Takes ownership of the 32-bit aligned planes
+    HEBitmap *bitmap = HEBitmap_base(NULL);
+    
+    bitmap->width = width;
+    bitmap->height = height;
+    
+    _HEBitmap *prv = &bitmap->prv;
+    
+    prv->isOwner = 1;
+    prv->freeData = 1;
+    
+    prv->bw = width;
+    prv->bh = height;
+    prv->rowbytes = rowbytes;
+    
+    prv->data = data;
+    prv->mask = mask;
+    prv->hasMask = mask ? 1 : 0;
+    
+    he_memory_alloc(HEMemoryPlanes, (data ? HEBitmap_planeSize(prv) : 0) + (mask ? HEBitmap_planeSize(prv) : 0));
+    
+    HEBitmap_eliminatePlanes(bitmap);
+    
+    return bitmap;
+}
+
 HEBitmap* HEBitmap_loadHEB(const char *filename)
 {
-    SDFile *file = playdate->file->open(filename, kFileRead);
-    if(!file)
+    _HEReader reader;
+    if(!HEReader_openFile(&reader, filename))
     {
         return NULL;
     }
     
-    playdate->file->seek(file, 0, SEEK_END);
-    unsigned int file_size = playdate->file->tell(file);
-    playdate->file->seek(file, 0, SEEK_SET);
-
-    uint8_t *buffer = playdate->system->realloc(NULL, file_size);
-    if(buffer)
+    // Read version
+    uint32_t version = HEReader_uint32(&reader);
+    
+    int compressed = 0;
+    if(version >= 3)
     {
-        playdate->file->read(file, buffer, file_size);
+        // Skip metadata
+        HEReader_skip(&reader, 7 * 4 + 1);
+        compressed = HEReader_uint8(&reader);
     }
-    playdate->file->close(file);
     
-    if(!buffer)
+    HEReader_seek(&reader, 0);
+    
+    if(!compressed)
     {
-        allocation_failed();
-        return NULL;
+        // Raw data is used in place, read the whole file
+        if(!HEReader_toBuffer(&reader))
+        {
+            HEReader_close(&reader);
+            return NULL;
+        }
     }
     
     int retainBuffer;
-    HEBitmap *bitmap = HEBitmap_fromBuffer(buffer, 1, &retainBuffer, NULL, 0);
-    if(!retainBuffer)
+    HEBitmap *bitmap = HEBitmap_fromReader(&reader, 1, &retainBuffer, NULL, 0);
+    if(reader.rawBuffer && !retainBuffer)
     {
-        playdate->system->realloc(buffer, 0);
+        playdate->system->realloc(reader.rawBuffer, 0);
+        he_memory_free(HEMemoryRawBuffers, reader.buffer_len);
     }
+    HEReader_close(&reader);
+    
     return bitmap;
 }
 
-static void decompress(uint8_t *dst, uint8_t **buffer, size_t len)
+HEBitmap* HEBitmap_fromMemory(const uint8_t *bytes, size_t len)
 {
-    size_t i = 0;
-    
-    while(i < len)
+    if(len < he_format_bitmap_header_size(1))
     {
-        uint8_t count = **buffer;
-        (*buffer)++;
-        uint8_t data = **buffer;
-        (*buffer)++;
-        size_t end = i + count;
-        if(end > len)
-        {
-            end = len;
-        }
-        while(i < end)
-        {
-            dst[i++] = data;
-        }
+        return NULL;
     }
+    
+    // Raw planes point to the memory, compressed planes are decompressed
+    _HEReader reader = HEReader_zero();
+    reader.buffer = bytes;
+    reader.buffer_ptr = bytes;
+    reader.buffer_len = len;
+    
+    int retainBuffer;
+    return HEBitmap_fromReader(&reader, 1, &retainBuffer, NULL, 0);
 }
 
-static HEBitmap* HEBitmap_fromBuffer(uint8_t *buffer, int isOwner, int *retainBuffer, _HEBitmapAllocator *allocator, int useAllocator)
+static HEBitmap* HEBitmap_fromReader(_HEReader *reader, int isOwner, int *retainBuffer, _HEBitmapAllocator *allocator, int useAllocator)
 {
     HEBitmap *bitmap = HEBitmap_base(allocator);
     _HEBitmap *prv = &bitmap->prv;
     
     prv->isOwner = isOwner;
     
-    uint8_t *buffer_ptr = buffer;
-    
     // Read version
-    uint32_t version = read_uint32(&buffer_ptr);
+    uint32_t version = HEReader_uint32(reader);
     
-    bitmap->width = read_uint32(&buffer_ptr);
-    bitmap->height = read_uint32(&buffer_ptr);
-    prv->bx = read_uint32(&buffer_ptr);
-    prv->by = read_uint32(&buffer_ptr);
-    prv->bw = read_uint32(&buffer_ptr);
-    prv->bh = read_uint32(&buffer_ptr);
-    prv->rowbytes = read_uint32(&buffer_ptr);
-    prv->hasMask = read_uint8(&buffer_ptr);
+    bitmap->width = HEReader_uint32(reader);
+    bitmap->height = HEReader_uint32(reader);
+    prv->bx = HEReader_uint32(reader);
+    prv->by = HEReader_uint32(reader);
+    prv->bw = HEReader_uint32(reader);
+    prv->bh = HEReader_uint32(reader);
+    prv->rowbytes = HEReader_uint32(reader);
+    prv->hasMask = HEReader_uint8(reader);
     
     int compressed = 0;
     if(version >= 3)
     {
         // Version 3 supports compression
-        compressed = read_uint8(&buffer_ptr);
+        compressed = HEReader_uint8(reader);
+    }
+    
+    uint8_t fill = HE_FORMAT_FILL_NONE;
+    if(version >= 7)
+    {
+        // Version 7 supports fill
+        fill = HEReader_uint8(reader);
+        if(fill != HE_FORMAT_FILL_NONE && prv->hasMask)
+        {
+            prv->hasFill = 1;
+            prv->fill = (fill == HE_FORMAT_FILL_WHITE) ? 0xFFFFFFFF : 0x00000000;
+        }
     }
     
     if(version >= 2)
     {
         // Version 2 supports padding
-        uint32_t padding_len = read_uint32(&buffer_ptr);
-        buffer_ptr += padding_len;
+        uint32_t padding_len = HEReader_uint32(reader);
+        HEReader_skip(reader, padding_len);
+    }
+    
+    if(reader->overrun || !HEBitmap_validHeader(bitmap))
+    {
+        return HEBitmap_fromReaderFailed(bitmap, retainBuffer);
     }
+    
+    size_t data_size = (size_t)prv->rowbytes * prv->bh;
+    size_t planes_size = (prv->hasFill ? 0 : data_size) + (prv->hasMask ? data_size : 0);
+    
+    if(!compressed && !reader->file)
+    {
+        // Raw planes alias the buffer, they are only read
+        if(!prv->hasFill)
+        {
+            prv->data = (uint8_t*)reader->buffer_ptr;
+            HEReader_skip(reader, data_size);
+        }
         
-    if(compressed)
+        if(prv->hasMask)
+        {
+            prv->mask = (uint8_t*)reader->buffer_ptr;
+            HEReader_skip(reader, data_size);
+        }
+        
+        // Kernels read planes as 32-bit words
+        if(reader->overrun || ((uintptr_t)prv->data % 4) != 0 || ((uintptr_t)prv->mask % 4) != 0)
+        {
+            return HEBitmap_fromReaderFailed(bitmap, retainBuffer);
+        }
+        
+        if(isOwner)
+        {
+            prv->rawBuffer = reader->rawBuffer;
+            prv->rawBufferSize = reader->rawBuffer ? reader->buffer_len : 0;
+        }
+        
+        *retainBuffer = 1;
+    }
+    else
     {
         if(allocator && allocator->data && useAllocator)
         {
-            size_t data_size = prv->rowbytes * prv->bh;
-                
-            prv->data = allocator->data_ptr;
-            decompress(allocator->data_ptr, &buffer_ptr, data_size);
-            allocator->data_ptr += data_size;
+            if(planes_size > (allocator->dataSize - (allocator->data_ptr - allocator->data)))
+            {
+                // Frame larger than the table allocator
+                return HEBitmap_fromReaderFailed(bitmap, retainBuffer);
+            }
+            
+            if(!prv->hasFill)
+            {
+                prv->data = allocator->data_ptr;
+                allocator->data_ptr += data_size;
+            }
             
-            if(bitmap->prv.hasMask)
+            if(prv->hasMask)
             {
-                bitmap->prv.mask = allocator->data_ptr;
-                decompress(allocator->data_ptr, &buffer_ptr, data_size);
+                prv->mask = allocator->data_ptr;
                 allocator->data_ptr += data_size;
             }
         }
@@ -261,49 +385,175 @@ static HEBitmap* HEBitmap_fromBuffer(uint8_t *buffer, int isOwner, int *retainBu
         {
             prv->freeData = 1;
             
-            size_t data_size = prv->rowbytes * prv->bh;
-            
-            prv->data = playdate->system->realloc(NULL, data_size);
-            decompress(prv->data, &buffer_ptr, data_size);
+            if(!prv->hasFill)
+            {
+                prv->data = playdate->system->realloc(NULL, HEBitmap_planeSize(prv));
+                if(!prv->data)
+                {
+                    allocation_failed();
+                    return HEBitmap_fromReaderFailed(bitmap, retainBuffer);
+                }
+                he_memory_alloc(HEMemoryPlanes, HEBitmap_planeSize(prv));
+            }
             
             if(prv->hasMask)
             {
-                prv->mask = playdate->system->realloc(NULL, data_size);
-                decompress(prv->mask, &buffer_ptr, data_size);
+                prv->mask = playdate->system->realloc(NULL, HEBitmap_planeSize(prv));
+                if(!prv->mask)
+                {
+                    allocation_failed();
+                    return HEBitmap_fromReaderFailed(bitmap, retainBuffer);
+                }
+                he_memory_alloc(HEMemoryPlanes, HEBitmap_planeSize(prv));
             }
         }
         
-        *retainBuffer = 0;
-    }
-    else
-    {
-        if(isOwner)
+        // Decompress (or copy) straight into the planes
+        if(!prv->hasFill)
         {
-            prv->rawBuffer = buffer;
+            HEReader_readData(reader, prv->data, data_size, compressed);
         }
-        prv->data = buffer_ptr;
         
         if(prv->hasMask)
         {
-            buffer_ptr += prv->rowbytes * prv->bh;
-            prv->mask = buffer_ptr;
+            HEReader_readData(reader, prv->mask, data_size, compressed);
         }
         
-        *retainBuffer = 1;
+        *retainBuffer = 0;
+        
+        if(reader->overrun)
+        {
+            return HEBitmap_fromReaderFailed(bitmap, retainBuffer);
+        }
+    }
+    
+    if(version < 7)
+    {
+        // Version 7 planes are reduced by the encoder
+        HEBitmap_eliminatePlanes(bitmap);
     }
     
     return bitmap;
 }
 
+static int HEBitmap_validHeader(HEBitmap *bitmap)
+{
+    // Bounds in the bitmap, rows of 32-bit words
+    _HEBitmap *prv = &bitmap->prv;
+    
+    if(bitmap->width < 0 || bitmap->height < 0 || prv->bx < 0 || prv->by < 0 || prv->bw < 0 || prv->bh < 0 || prv->rowbytes < 0)
+    {
+        return 0;
+    }
+    if(prv->bw > (bitmap->width - prv->bx) || prv->bh > (bitmap->height - prv->by))
+    {
+        return 0;
+    }
+    if((prv->rowbytes % 4) != 0 || ((size_t)prv->bw + 31) / 32 * 4 > (size_t)prv->rowbytes)
+    {
+        return 0;
+    }
+    // Kernels index planes with int
+    if(prv->bh > 0 && prv->rowbytes > (INT_MAX / prv->bh))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+static HEBitmap* HEBitmap_fromReaderFailed(HEBitmap *bitmap, int *retainBuffer)
+{
+    // Truncated or invalid data, owned planes are freed and table bitmaps are left empty
+    _HEBitmap *prv = &bitmap->prv;
+    
+    if(prv->freeData)
+    {
+        if(prv->data)
+        {
+            playdate->system->realloc(prv->data, 0);
+            he_memory_free(HEMemoryPlanes, HEBitmap_planeSize(prv));
+        }
+        if(prv->mask)
+        {
+            playdate->system->realloc(prv->mask, 0);
+            he_memory_free(HEMemoryPlanes, HEBitmap_planeSize(prv));
+        }
+    }
+    
+    prv->data = NULL;
+    prv->mask = NULL;
+    prv->freeData = 0;
+    prv->rawBuffer = NULL;
+    prv->rawBufferSize = 0;
+    
+    *retainBuffer = 0;
+    
+    if(prv->freeSelf)
+    {
+        playdate->system->realloc(bitmap, 0);
+        he_memory_free(HEMemoryMetadata, sizeof(HEBitmap));
+    }
+    
+    return NULL;
+}
+
+static void HEBitmap_eliminatePlanes(HEBitmap *bitmap)
+{
+    _HEBitmap *prv = &bitmap->prv;
+    
+    if(!prv->mask || prv->hasFill)
+    {
+        return;
+    }
+    
+    if(he_format_mask_is_opaque(prv->mask, prv->rowbytes, prv->bw, prv->bh))
+    {
+        // Every pixel in bounds is opaque, drop the mask
+        if(prv->freeData)
+        {
+            playdate->system->realloc(prv->mask, 0);
+            he_memory_free(HEMemoryPlanes, HEBitmap_planeSize(prv));
+        }
+        prv->mask = NULL;
+        prv->hasMask = 0;
+        return;
+    }
+    
+    uint8_t fill = he_format_fill(prv->data, prv->mask, prv->rowbytes, prv->bw, prv->bh);
+    if(fill != HE_FORMAT_FILL_NONE)
+    {
+        // Visible pixels have the same color, drop the data plane
+        if(prv->freeData)
+        {
+            playdate->system->realloc(prv->data, 0);
+            he_memory_free(HEMemoryPlanes, HEBitmap_planeSize(prv));
+        }
+        prv->data = NULL;
+        prv->hasFill = 1;
+        prv->fill = (fill == HE_FORMAT_FILL_WHITE) ? 0xFFFFFFFF : 0x00000000;
+    }
+}
+
 void HEBitmap_draw(HEBitmap *bitmap, int x, int y)
 {
-    if(bitmap->prv.mask)
+    HEBitmap_drawInContext(bitmap, x, y, he_graphics_context);
+}
+
+void HEBitmap_drawInContext(HEBitmap *bitmap, int x, int y, HEGraphicsContext *context)
+{
+    HE_STATS_ADD(drawCalls, 1);
+    
+    if(bitmap->prv.hasFill)
+    {
+        HEBitmap_drawFill(playdate, context, bitmap, x, y);
+    }
+    else if(bitmap->prv.mask)
     {
-        HEBitmap_drawMask(playdate, bitmap, x, y);
+        HEBitmap_drawMask(playdate, context, bitmap, x, y);
     }
     else
     {
-        HEBitmap_drawOpaque(playdate, bitmap, x, y);
+        HEBitmap_drawOpaque(playdate, context, bitmap, x, y);
     }
 }
 
@@ -315,7 +565,7 @@ LCDColor HEBitmap_colorAt(HEBitmap *bitmap, int x, int y)
     {
         int src_x = x - prv->bx;
         int src_y = y - prv->by;
-
+        
         int i = src_y * prv->rowbytes + (unsigned int)src_x / 8;
         uint8_t bitmask = (1 << (7 - (unsigned int)src_x % 8));
         
@@ -323,6 +573,10 @@ LCDColor HEBitmap_colorAt(HEBitmap *bitmap, int x, int y)
         {
             return kColorClear;
         }
+        else if(prv->hasFill)
+        {
+            return prv->fill ? kColorWhite : kColorBlack;
+        }
         else if(prv->data[i] & bitmask)
         {
             return kColorWhite;
@@ -356,27 +610,82 @@ void HEBitmap_getData(HEBitmap *bitmap, uint8_t **data, uint8_t **mask, int *row
     *bh = prv->bh;
 }
 
+int HEBitmap_getFill(HEBitmap *bitmap, LCDColor *color)
+{
+    _HEBitmap *prv = &bitmap->prv;
+    
+    if(!prv->hasFill)
+    {
+        return 0;
+    }
+    
+    if(color)
+    {
+        *color = prv->fill ? kColorWhite : kColorBlack;
+    }
+    
+    return 1;
+}
+
+HEMemoryUsage HEBitmap_memoryUsage(HEBitmap *bitmap)
+{
+    _HEBitmap *prv = &bitmap->prv;
+    
+    HEMemoryUsage usage = {0};
+    
+    if(prv->freeData)
+    {
+        usage.planes += (prv->data ? HEBitmap_planeSize(prv) : 0) + (prv->mask ? HEBitmap_planeSize(prv) : 0);
+    }
+    if(prv->rawBuffer)
+    {
+        usage.rawBuffers += prv->rawBufferSize;
+    }
+    if(prv->freeSelf)
+    {
+        usage.metadata += sizeof(HEBitmap);
+    }
+    
+    usage.total = usage.planes + usage.rawBuffers + usage.metadata;
+    
+    return usage;
+}
+
+static size_t HEBitmap_planeSize(_HEBitmap *prv)
+{
+    // Planes are allocated with at least 1 byte
+    size_t size = (size_t)prv->rowbytes * prv->bh;
+    return (size > 0) ? size : 1;
+}
+
 void _HEBitmap_free(HEBitmap *bitmap)
 {
     _HEBitmap *prv = &bitmap->prv;
     
     if(prv->freeData)
     {
-        playdate->system->realloc(prv->data, 0);
+        if(prv->data)
+        {
+            playdate->system->realloc(prv->data, 0);
+            he_memory_free(HEMemoryPlanes, HEBitmap_planeSize(prv));
+        }
         if(prv->mask)
         {
             playdate->system->realloc(prv->mask, 0);
+            he_memory_free(HEMemoryPlanes, HEBitmap_planeSize(prv));
         }
     }
     
     if(prv->rawBuffer)
     {
         playdate->system->realloc(prv->rawBuffer, 0);
+        he_memory_free(HEMemoryRawBuffers, prv->rawBufferSize);
     }
     
     if(prv->freeSelf)
     {
         playdate->system->realloc(bitmap, 0);
+        he_memory_free(HEMemoryMetadata, sizeof(HEBitmap));
     }
 }
 
@@ -389,261 +698,1682 @@ void HEBitmap_free(HEBitmap *bitmap)
         return;
     }
     
+    if(prv->isShared && he_cache_release(bitmap, prv->sharedHash))
+    {
+        // Freed by he_cache_purgeUnused
+        return;
+    }
+    
     _HEBitmap_free(bitmap);
 }
 
 //
-// Bitmap table
+// Bitmap (save-under)
 //
-HEBitmapTable* HEBitmapTable_base(void)
+HESaveUnder* HESaveUnder_new(void)
 {
-    HEBitmapTable *bitmapTable = playdate->system->realloc(NULL, sizeof(HEBitmapTable));
-    
-    bitmapTable->length = 0;
-    
-    _HEBitmapTable *prv = &bitmapTable->prv;
-    
-    prv->rawBuffer = NULL;
-    prv->allocator = HEBitmapAllocator_zero();
+    HESaveUnder *saveUnder = playdate->system->realloc(NULL, sizeof(HESaveUnder));
+    he_memory_alloc(HEMemoryMetadata, sizeof(HESaveUnder));
+    
+    _HESaveUnder *prv = &saveUnder->prv;
+    prv->buffer = NULL;
+    prv->bufferSize = 0;
+    prv->frame = NULL;
+    prv->width = 0;
+    prv->height = 0;
+    prv->rowbytes = 0;
+    prv->word = 0;
+    prv->y = 0;
+    prv->words = 0;
+    prv->rows = 0;
     
-    return bitmapTable;
+    return saveUnder;
 }
 
-HEBitmapTable* HEBitmapTable_load(const char *filename)
+void HEBitmap_drawSaved(HEBitmap *bitmap, int x, int y, HESaveUnder *saveUnder)
 {
-    LCDBitmapTable *lcd_bitmapTable = playdate->graphics->loadBitmapTable(filename, NULL);
-    if(lcd_bitmapTable)
-    {
-        HEBitmapTable *bitmapTable = HEBitmapTable_fromLCDBitmapTable(lcd_bitmapTable);
-        playdate->graphics->freeBitmapTable(lcd_bitmapTable);
-        return bitmapTable;
-    }
-    return NULL;
+    HEBitmap_drawSavedInContext(bitmap, x, y, saveUnder, he_graphics_context);
 }
 
-HEBitmapTable* HEBitmapTable_fromLCDBitmapTable(LCDBitmapTable *lcd_bitmapTable)
+void HEBitmap_drawSavedInContext(HEBitmap *bitmap, int x, int y, HESaveUnder *saveUnder, HEGraphicsContext *context)
 {
-    HEBitmapTable *bitmapTable = HEBitmapTable_base();
-    _HEBitmapTable *prv = &bitmapTable->prv;
-    
-    int length;
-    playdate->graphics->getBitmapTableInfo(lcd_bitmapTable, &length, NULL);
-    bitmapTable->length = length;
+    _HEBitmap *bitmap_prv = &bitmap->prv;
+    _HESaveUnder *prv = &saveUnder->prv;
     
-    HEBitmapAllocator_alloc_bitmaps(&prv->allocator, length);
+    prv->rows = 0;
     
-    int valid = 1;
+    int bitmap_x = x + bitmap_prv->bx;
+    int bitmap_y = y + bitmap_prv->by;
+    HERect clipRect = context->clipRect;
     
-    for(int i = 0; i < length; i++)
+    // Same bounds as the draw kernels
+    if((bitmap_x + bitmap_prv->bw) > clipRect.x && bitmap_x < (clipRect.x + clipRect.width) && (bitmap_y + bitmap_prv->bh) > clipRect.y && bitmap_y < (clipRect.y + clipRect.height))
     {
-        LCDBitmap *lcd_bitmap = playdate->graphics->getTableBitmap(lcd_bitmapTable, i);
-        HEBitmap *bitmap = _HEBitmap_fromLCDBitmap(lcd_bitmap, 0, &prv->allocator);
-        if(!bitmap)
+        unsigned int x1, y1, x2, y2, offset_left, offset_top;
+        he_bitmap_clip_bounds(bitmap, bitmap_x, bitmap_y, &x1, &y1, &x2, &y2, &offset_left, &offset_top, clipRect);
+        
+        int word = x1 / 32;
+        int words = (x2 - 1) / 32 - word + 1;
+        int rows = y2 - y1;
+        size_t size = (size_t)words * 4 * rows;
+        
+        if(prv->bufferSize < size)
         {
-            valid = 0;
-            break;
-        }
-    }
+            uint8_t *buffer = playdate->system->realloc(prv->buffer, size);
+            if(buffer)
+            {
+                he_memory_alloc(HEMemoryPlanes, size - prv->bufferSize);
+                prv->buffer = buffer;
+                prv->bufferSize = size;
+            }
+            else
+            {
+                // Drawn without saving
+                allocation_failed();
+                rows = 0;
+            }
+        }
+        
+        uint8_t *frame = he_graphics_frame(context) + y1 * context->rowbytes + word * 4;
+        for(int row = 0; row < rows; row++)
+        {
+            memcpy(prv->buffer + (size_t)row * words * 4, frame, words * 4);
+            frame += context->rowbytes;
+        }
+        
+        prv->frame = context->frame;
+        prv->width = context->width;
+        prv->height = context->height;
+        prv->rowbytes = context->rowbytes;
+        prv->word = word;
+        prv->y = y1;
+        prv->words = words;
+        prv->rows = rows;
+    }
+    
+    HEBitmap_drawInContext(bitmap, x, y, context);
+}
+
+void HEBitmap_restore(HESaveUnder *saveUnder)
+{
+    _HESaveUnder *prv = &saveUnder->prv;
+    
+    if(prv->rows == 0)
+    {
+        return;
+    }
+    
+    // Frame of the saved words
+    HEGraphicsContext context = he_graphics_context_new(prv->frame, prv->width, prv->height, prv->rowbytes);
+    
+    uint8_t *frame = he_graphics_frame(&context) + prv->y * prv->rowbytes + prv->word * 4;
+    for(int row = 0; row < prv->rows; row++)
+    {
+        memcpy(frame, prv->buffer + (size_t)row * prv->words * 4, prv->words * 4);
+        frame += prv->rowbytes;
+    }
+    
+    he_graphics_markUpdatedRows(&context, prv->y, prv->y + prv->rows - 1);
+    
+    // Words are restored once
+    prv->rows = 0;
+}
+
+void HESaveUnder_free(HESaveUnder *saveUnder)
+{
+    _HESaveUnder *prv = &saveUnder->prv;
+    
+    if(prv->buffer)
+    {
+        playdate->system->realloc(prv->buffer, 0);
+        he_memory_free(HEMemoryPlanes, prv->bufferSize);
+    }
+    
+    playdate->system->realloc(saveUnder, 0);
+    he_memory_free(HEMemoryMetadata, sizeof(HESaveUnder));
+}
+
+//
+// Bitmap table
+//
+HEBitmapTable* HEBitmapTable_base(void)
+{
+    HEBitmapTable *bitmapTable = playdate->system->realloc(NULL, sizeof(HEBitmapTable));
+    he_memory_alloc(HEMemoryMetadata, sizeof(HEBitmapTable));
+    
+    bitmapTable->length = 0;
+    
+    _HEBitmapTable *prv = &bitmapTable->prv;
+    
+    prv->rawBuffer = NULL;
+    prv->rawBufferSize = 0;
+    prv->allocator = HEBitmapAllocator_zero();
+    prv->deltas = NULL;
+    prv->playbackData = NULL;
+    prv->playbackSize = 0;
+    prv->playbackIndex = -1;
+    prv->nextFrame = 0;
+    prv->lastFrame = -1;
+    prv->lastX = 0;
+    prv->lastY = 0;
+    prv->lastClipRect = he_rect_zero();
+    prv->lastTarget = NULL;
+    prv->isShared = 0;
+    prv->sharedHash = 0;
+    
+    return bitmapTable;
+}
+
+HEBitmapTable* HEBitmapTable_load(const char *filename)
+{
+    return HEBitmapTable_endLoad(HEBitmapTable_beginLoad(filename));
+}
+
+HEBitmapTable* HEBitmapTable_fromLCDBitmapTable(LCDBitmapTable *lcd_bitmapTable)
+{
+    return HEBitmapTable_endLoad(HEBitmapTableLoader_fromLCDBitmapTable(lcd_bitmapTable, 0));
+}
+
+HEBitmapTable* HEBitmapTable_loadHEBT(const char *filename)
+{
+    return HEBitmapTable_loadHEBT_options(filename, 1);
+}
+
+HEBitmapTable* HEBitmapTable_loadHEBT_options(const char *filename, int useAllocator)
+{
+    return HEBitmapTable_endLoad(HEBitmapTable_beginLoadHEBT_options(filename, useAllocator));
+}
+
+HEBitmapTable* HEBitmapTable_loadHEBT_range(const char *filename, unsigned int first, unsigned int count)
+{
+    return HEBitmapTable_endLoad(HEBitmapTable_beginLoadHEBT_range(filename, first, count));
+}
+
+HEBitmapTable* HEBitmapTable_fromMemory(const uint8_t *bytes, size_t len)
+{
+    if(len < 8)
+    {
+        return NULL;
+    }
+    
+    // Raw frames point to the memory, compressed frames are decompressed
+    _HEReader reader = HEReader_zero();
+    reader.buffer = bytes;
+    reader.buffer_ptr = bytes;
+    reader.buffer_len = len;
+    
+    return HEBitmapTable_endLoad(HEBitmapTableLoader_fromReader(reader, 1, 1));
+}
+
+HEBitmap* HEBitmap_atIndex(HEBitmapTable *bitmapTable, unsigned int index)
+{
+    _HEBitmapTable *prv = &bitmapTable->prv;
+    
+    if(index < bitmapTable->length)
+    {
+        HEBitmap *bitmap = &prv->allocator.bitmaps[index];
+        if(prv->deltas && prv->deltas[index].isDelta)
+        {
+            // Rebuild the frame in the playback buffer
+            HEBitmapTable_playback(bitmapTable, index);
+            bitmap->prv.data = prv->playbackData;
+        }
+        return bitmap;
+    }
+    
+    return NULL;
+}
+
+HEMemoryUsage HEBitmapTable_memoryUsage(HEBitmapTable *bitmapTable)
+{
+    _HEBitmapTable *prv = &bitmapTable->prv;
+    
+    HEMemoryUsage usage = {0};
+    
+    usage.metadata += sizeof(HEBitmapTable) + prv->allocator.bitmapsLength * sizeof(HEBitmap);
+    usage.planes += prv->allocator.dataSize;
+    
+    for(unsigned int i = 0; i < prv->allocator.bitmapsCount; i++)
+    {
+        HEMemoryUsage bitmapUsage = HEBitmap_memoryUsage(&prv->allocator.bitmaps[i]);
+        usage.planes += bitmapUsage.planes;
+        usage.rawBuffers += bitmapUsage.rawBuffers;
+    }
+    
+    if(prv->rawBuffer)
+    {
+        usage.rawBuffers += prv->rawBufferSize;
+    }
+    
+    if(prv->deltas)
+    {
+        usage.metadata += sizeof(_HEBitmapDelta) * bitmapTable->length;
+        for(unsigned int i = 0; i < bitmapTable->length; i++)
+        {
+            usage.planes += prv->deltas[i].runsSize;
+        }
+    }
+    
+    if(prv->playbackData)
+    {
+        usage.planes += prv->playbackSize + 4;
+    }
+    
+    usage.total = usage.planes + usage.rawBuffers + usage.metadata;
+    
+    return usage;
+}
+
+void HEBitmapTable_free(HEBitmapTable *bitmapTable)
+{
+    _HEBitmapTable *prv = &bitmapTable->prv;
+    
+    if(prv->isShared && he_cache_release(bitmapTable, prv->sharedHash))
+    {
+        // Freed by he_cache_purgeUnused
+        return;
+    }
+    
+    for(unsigned int i = 0; i < prv->allocator.bitmapsCount; i++)
+    {
+        HEBitmap *bitmap = &prv->allocator.bitmaps[i];
+        _HEBitmap_free(bitmap);
+    }
+    
+    if(prv->rawBuffer)
+    {
+        playdate->system->realloc(prv->rawBuffer, 0);
+        he_memory_free(HEMemoryRawBuffers, prv->rawBufferSize);
+    }
+    
+    if(prv->deltas)
+    {
+        for(unsigned int i = 0; i < bitmapTable->length; i++)
+        {
+            if(prv->deltas[i].runs)
+            {
+                playdate->system->realloc(prv->deltas[i].runs, 0);
+                he_memory_free(HEMemoryPlanes, prv->deltas[i].runsSize);
+            }
+        }
+        playdate->system->realloc(prv->deltas, 0);
+        he_memory_free(HEMemoryMetadata, sizeof(_HEBitmapDelta) * bitmapTable->length);
+    }
+    
+    if(prv->playbackData)
+    {
+        playdate->system->realloc(prv->playbackData, 0);
+        he_memory_free(HEMemoryPlanes, prv->playbackSize + 4);
+    }
+    
+    HEBitmapAllocator_free(&prv->allocator);
+    
+    playdate->system->realloc(bitmapTable, 0);
+    he_memory_free(HEMemoryMetadata, sizeof(HEBitmapTable));
+}
+
+//
+// Bitmap table (sequential playback)
+//
+void HEBitmapTable_drawNextFrame(HEBitmapTable *bitmapTable, int x, int y)
+{
+    HEBitmapTable_drawNextFrameInContext(bitmapTable, x, y, he_graphics_context);
+}
+
+void HEBitmapTable_drawNextFrameInContext(HEBitmapTable *bitmapTable, int x, int y, HEGraphicsContext *context)
+{
+    _HEBitmapTable *prv = &bitmapTable->prv;
+    
+    if(bitmapTable->length == 0)
+    {
+        return;
+    }
+    
+    unsigned int index = prv->nextFrame;
+    HERect clipRect = context->clipRect;
+    
+    // The previous frame is still in the framebuffer
+    int sequential = (index > 0 && prv->lastFrame == (int)(index - 1) && prv->lastTarget == context->frame && prv->lastX == x && prv->lastY == y && clipRect.x == prv->lastClipRect.x && clipRect.y == prv->lastClipRect.y && clipRect.width == prv->lastClipRect.width && clipRect.height == prv->lastClipRect.height);
+    
+    HEBitmap *bitmap = HEBitmap_atIndex(bitmapTable, index);
+    
+    if(sequential && prv->deltas && prv->deltas[index].isDelta)
+    {
+        // Draw the changed words only
+        HE_STATS_ADD(drawCalls, 1);
+        HEBitmapTable_drawDelta(bitmap, &prv->deltas[index], x, y, context);
+    }
+    else if(sequential && !(prv->deltas && prv->deltas[index - 1].isDelta) && bitmap->prv.data == prv->allocator.bitmaps[index - 1].prv.data && bitmap->prv.mask == prv->allocator.bitmaps[index - 1].prv.mask)
+    {
+        // Shared frame, already drawn
+    }
+    else
+    {
+        HEBitmap_drawInContext(bitmap, x, y, context);
+    }
+    
+    prv->lastFrame = index;
+    prv->lastX = x;
+    prv->lastY = y;
+    prv->lastClipRect = clipRect;
+    prv->lastTarget = context->frame;
+    
+    prv->nextFrame = (index + 1) % bitmapTable->length;
+}
+
+void HEBitmapTable_setNextFrame(HEBitmapTable *bitmapTable, unsigned int index)
+{
+    _HEBitmapTable *prv = &bitmapTable->prv;
+    
+    prv->nextFrame = (bitmapTable->length > 0) ? (index % bitmapTable->length) : 0;
+    prv->lastFrame = -1;
+}
+
+unsigned int HEBitmapTable_getNextFrame(HEBitmapTable *bitmapTable)
+{
+    return bitmapTable->prv.nextFrame;
+}
+
+void HEBitmapTable_invalidatePlayback(HEBitmapTable *bitmapTable)
+{
+    // Next frame is drawn in full
+    bitmapTable->prv.lastFrame = -1;
+}
+
+static void HEBitmapTable_playback(HEBitmapTable *bitmapTable, unsigned int index)
+{
+    _HEBitmapTable *prv = &bitmapTable->prv;
+    
+    if(prv->playbackIndex == (int)index)
+    {
+        return;
+    }
+    
+    unsigned int keyframe = index;
+    while(keyframe > 0 && prv->deltas[keyframe].isDelta)
+    {
+        keyframe--;
+    }
+    
+    unsigned int start = keyframe + 1;
+    
+    if(prv->playbackIndex > (int)keyframe && prv->playbackIndex < (int)index)
+    {
+        // Continue from the current frame
+        start = prv->playbackIndex + 1;
+    }
+    else
+    {
+        _HEBitmap *keyframe_prv = &prv->allocator.bitmaps[keyframe].prv;
+        memcpy(prv->playbackData, keyframe_prv->data, (size_t)keyframe_prv->rowbytes * keyframe_prv->bh);
+    }
+    
+    for(unsigned int i = start; i <= index; i++)
+    {
+        _HEBitmapDelta *delta = &prv->deltas[i];
+        for(unsigned int j = 0; j < delta->runsCount; j++)
+        {
+            _HEDeltaRun *run = &delta->runs[j];
+            memcpy(prv->playbackData + run->offset, run->data, run->len);
+        }
+    }
+    
+    prv->playbackIndex = index;
+}
+
+static void HEBitmapTable_drawDelta(HEBitmap *bitmap, _HEBitmapDelta *delta, int x, int y, HEGraphicsContext *context)
+{
+    _HEBitmap *prv = &bitmap->prv;
+    
+    // Each run is drawn as a bitmap slice
+    HEBitmap slice = *bitmap;
+    _HEBitmap *slice_prv = &slice.prv;
+    
+    unsigned int i = 0;
+    while(i < delta->runsCount)
+    {
+        _HEDeltaRun *run = &delta->runs[i];
+        
+        // Merge runs with the same columns on consecutive rows
+        unsigned int rows = 1;
+        while((i + rows) < delta->runsCount)
+        {
+            _HEDeltaRun *next_run = &delta->runs[i + rows];
+            if(next_run->len != run->len || next_run->offset != (run->offset + rows * prv->rowbytes))
+            {
+                break;
+            }
+            rows++;
+        }
+        
+        int row = run->offset / prv->rowbytes;
+        int col = (run->offset % prv->rowbytes) * 8;
+        
+        slice_prv->data = prv->data + run->offset;
+        slice_prv->bx = prv->bx + col;
+        slice_prv->by = prv->by + row;
+        slice_prv->bw = he_min(run->len * 8, prv->bw - col);
+        slice_prv->bh = rows;
+        
+        if(slice_prv->bw > 0)
+        {
+            HEBitmap_drawOpaque(playdate, context, &slice, x, y);
+        }
+        
+        i += rows;
+    }
+}
+
+//
+// Bitmap table (incremental loading)
+//
+static HEBitmapTableLoader* HEBitmapTableLoader_base(void)
+{
+    HEBitmapTableLoader *loader = playdate->system->realloc(NULL, sizeof(HEBitmapTableLoader));
+    he_memory_alloc(HEMemoryMetadata, sizeof(HEBitmapTableLoader));
+    
+    loader->length = 0;
+    loader->loadedCount = 0;
+    
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    prv->bitmapTable = HEBitmapTable_base();
+    prv->lcd_bitmapTable = NULL;
+    prv->reader = HEReader_zero();
+    prv->frameIndex = NULL;
+    prv->frameIndexSize = 0;
+    prv->dictionary = NULL;
+    prv->dictionarySize = 0;
+    prv->firstFrame = 0;
+    prv->keyFrame = 0;
+    prv->freeLCDBitmapTable = 0;
+    prv->retainBuffer = 0;
+    prv->staticBuffer = 0;
+    prv->useAllocator = 0;
+    prv->failed = 0;
+    
+    return loader;
+}
+
+static HEBitmapTableLoader* HEBitmapTableLoader_fromLCDBitmapTable(LCDBitmapTable *lcd_bitmapTable, int freeLCDBitmapTable)
+{
+    HEBitmapTableLoader *loader = HEBitmapTableLoader_base();
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    prv->lcd_bitmapTable = lcd_bitmapTable;
+    prv->freeLCDBitmapTable = freeLCDBitmapTable;
+    
+    int length;
+    playdate->graphics->getBitmapTableInfo(lcd_bitmapTable, &length, NULL);
+    loader->length = length;
+    prv->bitmapTable->length = length;
+    
+    HEBitmapAllocator_alloc_bitmaps(&prv->bitmapTable->prv.allocator, length);
+    
+    return loader;
+}
+
+HEBitmapTableLoader* HEBitmapTable_beginLoad(const char *filename)
+{
+    LCDBitmapTable *lcd_bitmapTable = playdate->graphics->loadBitmapTable(filename, NULL);
+    if(lcd_bitmapTable)
+    {
+        return HEBitmapTableLoader_fromLCDBitmapTable(lcd_bitmapTable, 1);
+    }
+    return NULL;
+}
+
+HEBitmapTableLoader* HEBitmapTable_beginLoadHEBT(const char *filename)
+{
+    return HEBitmapTable_beginLoadHEBT_options(filename, 1);
+}
+
+HEBitmapTableLoader* HEBitmapTable_beginLoadHEBT_options(const char *filename, int useAllocator)
+{
+    _HEReader reader;
+    if(!HEReader_openFile(&reader, filename))
+    {
+        return NULL;
+    }
+    
+    // Read version
+    uint32_t version = HEReader_uint32(&reader);
+    
+    int compressed = 0;
+    if(version >= 3)
+    {
+        // Skip length
+        HEReader_skip(&reader, 4);
+        compressed = HEReader_uint8(&reader);
+    }
+    
+    HEReader_seek(&reader, 0);
+    
+    if(!compressed)
+    {
+        // Raw data is used in place, read the whole file
+        if(!HEReader_toBuffer(&reader))
+        {
+            HEReader_close(&reader);
+            return NULL;
+        }
+    }
+    
+    return HEBitmapTableLoader_fromReader(reader, 0, useAllocator);
+}
+
+static HEBitmapTableLoader* HEBitmapTableLoader_fromReader(_HEReader reader, int staticBuffer, int useAllocator)
+{
+    HEBitmapTableLoader *loader = HEBitmapTableLoader_base();
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    HEBitmapTable *bitmapTable = prv->bitmapTable;
+    _HEBitmapTable *table_prv = &bitmapTable->prv;
+    
+    prv->reader = reader;
+    prv->staticBuffer = staticBuffer;
+    prv->useAllocator = useAllocator;
+    
+    uint32_t version = HEReader_uint32(&prv->reader);
+    uint32_t length = HEReader_uint32(&prv->reader);
+    
+    // Each frame has at least a size word
+    if(prv->reader.overrun || (!prv->reader.file && length > (prv->reader.buffer_len / 4)))
+    {
+        HEBitmapTable_cancelLoad(loader);
+        return NULL;
+    }
+    
+    loader->length = length;
+    bitmapTable->length = length;
+    
+    HEBitmapAllocator_alloc_bitmaps(&table_prv->allocator, length);
+    
+    int compressed = 0;
+    uint32_t dictionarySize = 0;
+    if(version >= 3)
+    {
+        // Version 3 supports compression
+        compressed = HEReader_uint8(&prv->reader);
+        
+        if(version >= 4 && compressed)
+        {
+            // Version 4 supports allocator
+            uint32_t allocator_data_len = HEReader_uint32(&prv->reader);
+            if(useAllocator)
+            {
+                table_prv->allocator.data = playdate->system->realloc(NULL, allocator_data_len);
+                if(!table_prv->allocator.data)
+                {
+                    allocation_failed();
+                    HEBitmapTable_cancelLoad(loader);
+                    return NULL;
+                }
+                table_prv->allocator.data_ptr = table_prv->allocator.data;
+                table_prv->allocator.dataSize = allocator_data_len;
+                he_memory_alloc(HEMemoryPlanes, allocator_data_len);
+            }
+        }
+        
+        if(version >= 9 && compressed == HE_FORMAT_COMPRESSION_LZ)
+        {
+            // Version 9 supports dictionary, skip its compressed length
+            dictionarySize = HEReader_uint32(&prv->reader);
+            HEReader_skip(&prv->reader, 4);
+        }
+    }
+    
+    if(version >= 2)
+    {
+        // Version 2 supports padding
+        uint32_t padding_len = HEReader_uint32(&prv->reader);
+        HEReader_skip(&prv->reader, padding_len);
+    }
+    
+    // Frames are read in order
+    HEReader_skip(&prv->reader, he_format_table_index_size(version, length));
+    
+    if(prv->reader.overrun || !HEBitmapTableLoader_readDictionary(loader, dictionarySize))
+    {
+        HEBitmapTable_cancelLoad(loader);
+        return NULL;
+    }
+    
+    if(compressed && useAllocator && !table_prv->allocator.data)
+    {
+        // Compatibility mode
+        size_t table_position = HEReader_tell(&prv->reader);
+        size_t allocator_data_len = 0;
+        
+        for(uint32_t i = 0; i < length; i++)
+        {
+            uint32_t bitmap_size = HEReader_uint32(&prv->reader);
+            if(bitmap_size & HE_FORMAT_FRAME_REFERENCE)
+            {
+                // Shared frame, no data
+                continue;
+            }
+            if(bitmap_size & HE_FORMAT_FRAME_DELTA)
+            {
+                // Delta frame, not allocated
+                HEReader_skip(&prv->reader, bitmap_size & HE_FORMAT_FRAME_SIZE_MASK);
+                continue;
+            }
+            size_t bitmap_position = HEReader_tell(&prv->reader);
+            
+            uint32_t bitmap_version = HEReader_uint32(&prv->reader);
+            
+            // Skip metadata
+            HEReader_skip(&prv->reader, 4); // width
+            HEReader_skip(&prv->reader, 4); // height
+            HEReader_skip(&prv->reader, 4); // bx
+            HEReader_skip(&prv->reader, 4); // by
+            HEReader_skip(&prv->reader, 4); // bw
+            
+            int bh = HEReader_uint32(&prv->reader);
+            int rowbytes = HEReader_uint32(&prv->reader);
+            int hasMask = HEReader_uint8(&prv->reader);
+            
+            int hasFill = 0;
+            if(bitmap_version >= 7)
+            {
+                // Skip compressed
+                HEReader_skip(&prv->reader, 1);
+                hasFill = hasMask && HEReader_uint8(&prv->reader) != HE_FORMAT_FILL_NONE;
+            }
+            
+            if(!hasFill)
+            {
+                allocator_data_len += (size_t)rowbytes * bh;
+            }
+            if(hasMask)
+            {
+                allocator_data_len += (size_t)rowbytes * bh;
+            }
+            
+            HEReader_seek(&prv->reader, bitmap_position + bitmap_size);
+        }
+        
+        HEReader_seek(&prv->reader, table_position);
+        
+        if(prv->reader.overrun)
+        {
+            HEBitmapTable_cancelLoad(loader);
+            return NULL;
+        }
+        
+        table_prv->allocator.data = playdate->system->realloc(NULL, allocator_data_len);
+        if(!table_prv->allocator.data)
+        {
+            allocation_failed();
+            HEBitmapTable_cancelLoad(loader);
+            return NULL;
+        }
+        table_prv->allocator.data_ptr = table_prv->allocator.data;
+        table_prv->allocator.dataSize = allocator_data_len;
+        he_memory_alloc(HEMemoryPlanes, allocator_data_len);
+    }
+    
+    return loader;
+}
+
+HEBitmapTableLoader* HEBitmapTable_beginLoadHEBT_range(const char *filename, unsigned int first, unsigned int count)
+{
+    _HEReader reader;
+    if(!HEReader_openFile(&reader, filename))
+    {
+        return NULL;
+    }
+    
+    size_t file_size = HEReader_fileSize(&reader);
+    
+    uint32_t version = HEReader_uint32(&reader);
+    uint32_t length = HEReader_uint32(&reader);
+    
+    // Each frame has an index entry in the file, this also bounds the index allocation
+    if(length > (file_size / sizeof(HEFormatFrameIndex)))
+    {
+        playdate->system->logToConsole("HEBitmapTable: invalid length %u in %s", length, filename);
+        HEReader_close(&reader);
+        return NULL;
+    }
+    
+    if(version < 8 || first > length || count > (length - first))
+    {
+        playdate->system->logToConsole("HEBitmapTable: cannot load frames %u-%u of %s", first, first + count, filename);
+        HEReader_close(&reader);
+        return NULL;
+    }
+    
+    // Frames are read from the file and copied, the file is not buffered
+    uint8_t compressed = HEReader_uint8(&reader);
+    if(compressed)
+    {
+        // Skip allocator length
+        HEReader_skip(&reader, 4);
+    }
+    
+    uint32_t dictionarySize = 0;
+    if(version >= 9 && compressed == HE_FORMAT_COMPRESSION_LZ)
+    {
+        dictionarySize = HEReader_uint32(&reader);
+        HEReader_skip(&reader, 4);
+    }
+    
+    uint32_t padding_len = HEReader_uint32(&reader);
+    HEReader_skip(&reader, padding_len);
+    
+    size_t frameIndexSize = sizeof(HEFormatFrameIndex) * length + 1;
+    HEFormatFrameIndex *frameIndex = playdate->system->realloc(NULL, frameIndexSize);
+    if(!frameIndex)
+    {
+        allocation_failed();
+        HEReader_close(&reader);
+        return NULL;
+    }
+    he_memory_alloc(HEMemoryMetadata, frameIndexSize);
+    
+    int validIndex = 1;
+    
+    for(uint32_t i = 0; i < length; i++)
+    {
+        frameIndex[i].offset = HEReader_uint32(&reader);
+        frameIndex[i].size = HEReader_uint32(&reader);
+        
+        // Frames (not references) are in the file
+        size_t frame_size = frameIndex[i].size & HE_FORMAT_FRAME_SIZE_MASK;
+        if(!(frameIndex[i].size & HE_FORMAT_FRAME_REFERENCE) && (frameIndex[i].offset > file_size || frame_size > (file_size - frameIndex[i].offset)))
+        {
+            validIndex = 0;
+        }
+    }
+    
+    if(!validIndex || reader.overrun)
+    {
+        playdate->system->logToConsole("HEBitmapTable: invalid frame index in %s", filename);
+        playdate->system->realloc(frameIndex, 0);
+        he_memory_free(HEMemoryMetadata, frameIndexSize);
+        HEReader_close(&reader);
+        return NULL;
+    }
+    
+    // Delta frames need the previous frames, back to a keyframe
+    unsigned int keyFrame = first;
+    while(count > 0 && keyFrame > 0 && (frameIndex[keyFrame].size & HE_FORMAT_FRAME_DELTA))
+    {
+        keyFrame--;
+    }
+    
+    if(count > 0 && (frameIndex[keyFrame].size & HE_FORMAT_FRAME_DELTA))
+    {
+        playdate->system->logToConsole("HEBitmapTable: frame %u of %s has no keyframe", first, filename);
+        playdate->system->realloc(frameIndex, 0);
+        he_memory_free(HEMemoryMetadata, frameIndexSize);
+        HEReader_close(&reader);
+        return NULL;
+    }
+    
+    HEBitmapTableLoader *loader = HEBitmapTableLoader_base();
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    prv->reader = reader;
+    prv->frameIndex = frameIndex;
+    prv->frameIndexSize = frameIndexSize;
+    prv->firstFrame = first;
+    prv->keyFrame = keyFrame;
+    
+    loader->length = count;
+    prv->bitmapTable->length = count;
+    
+    HEBitmapAllocator_alloc_bitmaps(&prv->bitmapTable->prv.allocator, count);
+    
+    // The dictionary follows the frame index
+    if(!HEBitmapTableLoader_readDictionary(loader, dictionarySize))
+    {
+        HEBitmapTable_cancelLoad(loader);
+        return NULL;
+    }
+    
+    return loader;
+}
+
+static int HEBitmapTableLoader_readDictionary(HEBitmapTableLoader *loader, size_t dictionarySize)
+{
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    if(dictionarySize == 0)
+    {
+        return 1;
+    }
+    
+    // Needed until the frames are loaded
+    uint8_t *dictionary = playdate->system->realloc(NULL, dictionarySize);
+    if(!dictionary)
+    {
+        allocation_failed();
+        return 0;
+    }
+    he_memory_alloc(HEMemoryMetadata, dictionarySize);
+    
+    prv->dictionary = dictionary;
+    prv->dictionarySize = dictionarySize;
+    
+    // The dictionary itself has no dictionary
+    HEReader_readData(&prv->reader, dictionary, dictionarySize, HE_FORMAT_COMPRESSION_LZ);
+    
+    prv->reader.dictionary = dictionary;
+    prv->reader.dictionary_len = dictionarySize;
+    
+    return !prv->reader.overrun;
+}
+
+static uint32_t HEBitmapTableLoader_seekFrame(HEBitmapTableLoader *loader, unsigned int frame)
+{
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    HEFormatFrameIndex *entry = &prv->frameIndex[frame];
+    
+    if(entry->size & HE_FORMAT_FRAME_REFERENCE)
+    {
+        unsigned int index = entry->size & HE_FORMAT_FRAME_SIZE_MASK;
+        if(index >= frame)
+        {
+            return 0;
+        }
+        if(index >= prv->firstFrame)
+        {
+            return HE_FORMAT_FRAME_REFERENCE | (index - prv->firstFrame);
+        }
+        
+        // Shared frame before the range, load its data
+        entry = &prv->frameIndex[index];
+        if(entry->size & (HE_FORMAT_FRAME_REFERENCE | HE_FORMAT_FRAME_DELTA))
+        {
+            return 0;
+        }
+    }
+    
+    HEReader_seek(&prv->reader, entry->offset);
+    
+    return entry->size;
+}
+
+static int HEBitmapTableLoader_next(HEBitmapTableLoader *loader)
+{
+    _HEBitmapTableLoader *prv = &loader->prv;
+    _HEBitmapTable *table_prv = &prv->bitmapTable->prv;
+    
+    if(prv->lcd_bitmapTable)
+    {
+        LCDBitmap *lcd_bitmap = playdate->graphics->getTableBitmap(prv->lcd_bitmapTable, loader->loadedCount);
+        HEBitmap *bitmap = _HEBitmap_fromLCDBitmap(lcd_bitmap, 0, &table_prv->allocator);
+        if(!bitmap)
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        uint32_t bitmap_size;
+        if(prv->frameIndex && loader->loadedCount == 0 && prv->keyFrame < prv->firstFrame)
+        {
+            // Range starting on a delta frame
+            if(!HEBitmapTableLoader_firstDelta(loader))
+            {
+                return 0;
+            }
+            
+            loader->loadedCount++;
+            return 1;
+        }
+        
+        if(prv->frameIndex)
+        {
+            // Version 8 supports frame index
+            bitmap_size = HEBitmapTableLoader_seekFrame(loader, prv->firstFrame + loader->loadedCount);
+            if(bitmap_size == 0)
+            {
+                return 0;
+            }
+        }
+        else
+        {
+            bitmap_size = HEReader_uint32(&prv->reader);
+        }
+        
+        if(prv->reader.overrun)
+        {
+            return 0;
+        }
+        
+        if(bitmap_size & HE_FORMAT_FRAME_REFERENCE)
+        {
+            // Version 5 supports shared frames
+            unsigned int index = bitmap_size & HE_FORMAT_FRAME_SIZE_MASK;
+            if(index >= loader->loadedCount || (table_prv->deltas && table_prv->deltas[index].isDelta))
+            {
+                return 0;
+            }
+            
+            // Point to the same data without owning it
+            HEBitmap *bitmap = HEBitmap_base(&table_prv->allocator);
+            *bitmap = table_prv->allocator.bitmaps[index];
+            bitmap->prv.rawBuffer = NULL;
+            bitmap->prv.freeData = 0;
+            
+            loader->loadedCount++;
+            return 1;
+        }
+        
+        if(bitmap_size & HE_FORMAT_FRAME_DELTA)
+        {
+            // Version 6 supports delta frames
+            if(!HEBitmapTableLoader_nextDelta(loader, bitmap_size & HE_FORMAT_FRAME_SIZE_MASK))
+            {
+                return 0;
+            }
+            
+            loader->loadedCount++;
+            return 1;
+        }
+        
+        size_t bitmap_position = HEReader_tell(&prv->reader);
+        
+        int retainBufferBitmap;
+        if(!HEBitmap_fromReader(&prv->reader, 0, &retainBufferBitmap, &table_prv->allocator, prv->useAllocator))
+        {
+            return 0;
+        }
+        
+        if(retainBufferBitmap)
+        {
+            prv->retainBuffer = 1;
+        }
+        HEReader_seek(&prv->reader, bitmap_position + bitmap_size);
+    }
+    
+    loader->loadedCount++;
+    
+    return 1;
+}
+
+static int HEBitmapTableLoader_nextDelta(HEBitmapTableLoader *loader, size_t delta_size)
+{
+    _HEBitmapTableLoader *prv = &loader->prv;
+    _HEBitmapTable *table_prv = &prv->bitmapTable->prv;
+    
+    unsigned int index = loader->loadedCount;
+    if(index == 0 || delta_size < 4)
+    {
+        return 0;
+    }
+    
+    _HEBitmap *previous_prv = &table_prv->allocator.bitmaps[index - 1].prv;
+    if(previous_prv->mask)
+    {
+        // Delta frames are opaque
+        return 0;
+    }
+    
+    if(!table_prv->deltas)
+    {
+        size_t deltas_size = sizeof(_HEBitmapDelta) * loader->length;
+        table_prv->deltas = playdate->system->realloc(NULL, deltas_size);
+        if(!table_prv->deltas)
+        {
+            allocation_failed();
+            return 0;
+        }
+        he_memory_alloc(HEMemoryMetadata, deltas_size);
+        memset(table_prv->deltas, 0, deltas_size);
+    }
+    
+    size_t data_size = (size_t)previous_prv->rowbytes * previous_prv->bh;
+    
+    if(table_prv->playbackSize < data_size)
+    {
+        // Extra word for the kernel look-ahead
+        uint8_t *playbackData = playdate->system->realloc(table_prv->playbackData, data_size + 4);
+        if(!playbackData)
+        {
+            allocation_failed();
+            return 0;
+        }
+        if(table_prv->playbackData)
+        {
+            he_memory_free(HEMemoryPlanes, table_prv->playbackSize + 4);
+        }
+        he_memory_alloc(HEMemoryPlanes, data_size + 4);
+        memset(playbackData + data_size, 0, 4);
+        table_prv->playbackData = playbackData;
+        table_prv->playbackSize = data_size;
+    }
+    
+    uint32_t runsCount = HEReader_uint32(&prv->reader);
+    size_t runs_len = delta_size - 4;
+    if(((size_t)runsCount * 8) > runs_len)
+    {
+        return 0;
+    }
+    
+    size_t runs_data_len = runs_len - runsCount * 8;
+    size_t runsSize = sizeof(_HEDeltaRun) * runsCount + runs_data_len + 1;
+    _HEDeltaRun *runs = playdate->system->realloc(NULL, runsSize);
+    if(!runs)
+    {
+        allocation_failed();
+        return 0;
+    }
+    he_memory_alloc(HEMemoryPlanes, runsSize);
+    
+    _HEBitmapDelta *delta = &table_prv->deltas[index];
+    delta->runs = runs;
+    delta->runsCount = runsCount;
+    delta->runsSize = runsSize;
+    delta->isDelta = 1;
+    
+    // Same geometry as the previous frame, data is set by HEBitmap_atIndex
+    HEBitmap *bitmap = HEBitmap_base(&table_prv->allocator);
+    *bitmap = table_prv->allocator.bitmaps[index - 1];
+    bitmap->prv.rawBuffer = NULL;
+    bitmap->prv.freeData = 0;
+    bitmap->prv.data = NULL;
+    
+    uint8_t *runs_data = (uint8_t*)(runs + runsCount);
+    size_t rowbytes = previous_prv->rowbytes;
+    
+    for(uint32_t i = 0; i < runsCount; i++)
+    {
+        _HEDeltaRun *run = &runs[i];
+        run->offset = HEReader_uint32(&prv->reader);
+        run->len = HEReader_uint32(&prv->reader);
+        run->data = runs_data;
+        
+        // Word runs within a single row
+        if(run->len == 0 || run->len > runs_data_len || (run->offset % 4) != 0 || (run->len % 4) != 0 || run->offset >= data_size || ((run->offset % rowbytes) + run->len) > rowbytes)
+        {
+            return 0;
+        }
+        
+        HEReader_readData(&prv->reader, runs_data, run->len, 0);
+        runs_data += run->len;
+        runs_data_len -= run->len;
+    }
+    
+    return !prv->reader.overrun;
+}
+
+static int HEBitmapTableLoader_firstDelta(HEBitmapTableLoader *loader)
+{
+    _HEBitmapTableLoader *prv = &loader->prv;
+    _HEBitmapTable *table_prv = &prv->bitmapTable->prv;
+    
+    // The keyframe is loaded into the first bitmap and the deltas are applied to its data
+    uint32_t bitmap_size = HEBitmapTableLoader_seekFrame(loader, prv->keyFrame);
+    if(bitmap_size == 0 || (bitmap_size & (HE_FORMAT_FRAME_REFERENCE | HE_FORMAT_FRAME_DELTA)))
+    {
+        return 0;
+    }
+    
+    // Frames are copied from the file, the data is owned
+    int retainBuffer;
+    HEBitmap *bitmap = HEBitmap_fromReader(&prv->reader, 0, &retainBuffer, &table_prv->allocator, 0);
+    if(!bitmap)
+    {
+        return 0;
+    }
+    _HEBitmap *bitmap_prv = &bitmap->prv;
+    if(!bitmap_prv->data || bitmap_prv->mask)
+    {
+        // Delta frames are opaque
+        return 0;
+    }
+    
+    size_t data_size = (size_t)bitmap_prv->rowbytes * bitmap_prv->bh;
+    size_t rowbytes = bitmap_prv->rowbytes;
+    
+    for(unsigned int frame = prv->keyFrame + 1; frame <= prv->firstFrame; frame++)
+    {
+        HEFormatFrameIndex *entry = &prv->frameIndex[frame];
+        size_t delta_size = entry->size & HE_FORMAT_FRAME_SIZE_MASK;
+        if(!(entry->size & HE_FORMAT_FRAME_DELTA) || delta_size < 4)
+        {
+            return 0;
+        }
+        
+        HEReader_seek(&prv->reader, entry->offset);
+        
+        uint32_t runsCount = HEReader_uint32(&prv->reader);
+        if(((size_t)runsCount * 8) > (delta_size - 4))
+        {
+            return 0;
+        }
+        size_t runs_data_len = delta_size - 4 - runsCount * 8;
+        
+        for(uint32_t i = 0; i < runsCount; i++)
+        {
+            uint32_t offset = HEReader_uint32(&prv->reader);
+            uint32_t len = HEReader_uint32(&prv->reader);
+            
+            // Same runs as HEBitmapTableLoader_nextDelta
+            if(len == 0 || len > runs_data_len || (offset % 4) != 0 || (len % 4) != 0 || offset >= data_size || ((offset % rowbytes) + len) > rowbytes)
+            {
+                return 0;
+            }
+            
+            HEReader_readData(&prv->reader, bitmap_prv->data + offset, len, 0);
+            runs_data_len -= len;
+        }
+    }
+    
+    return 1;
+}
+
+int HEBitmapTable_loadStep(HEBitmapTableLoader *loader, unsigned int budget_ms)
+{
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    unsigned int start_time = playdate->system->getCurrentTimeMilliseconds();
+    
+    // At least one bitmap is loaded on each step
+    while(!prv->failed && loader->loadedCount < loader->length)
+    {
+        if(!HEBitmapTableLoader_next(loader))
+        {
+            prv->failed = 1;
+            break;
+        }
+        
+        unsigned int elapsed_time = playdate->system->getCurrentTimeMilliseconds() - start_time;
+        if(elapsed_time >= budget_ms)
+        {
+            break;
+        }
+    }
+    
+    return (prv->failed || loader->loadedCount >= loader->length);
+}
+
+float HEBitmapTable_loadProgress(HEBitmapTableLoader *loader)
+{
+    if(loader->length > 0)
+    {
+        return (float)loader->loadedCount / loader->length;
+    }
+    return 1;
+}
+
+static void HEBitmapTableLoader_free(HEBitmapTableLoader *loader)
+{
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    if(prv->lcd_bitmapTable && prv->freeLCDBitmapTable)
+    {
+        playdate->graphics->freeBitmapTable(prv->lcd_bitmapTable);
+    }
+    
+    if(prv->reader.rawBuffer && !prv->retainBuffer && !prv->staticBuffer)
+    {
+        playdate->system->realloc(prv->reader.rawBuffer, 0);
+        he_memory_free(HEMemoryRawBuffers, prv->reader.buffer_len);
+    }
+    
+    HEReader_close(&prv->reader);
+    
+    if(prv->frameIndex)
+    {
+        playdate->system->realloc(prv->frameIndex, 0);
+        he_memory_free(HEMemoryMetadata, prv->frameIndexSize);
+    }
+    
+    if(prv->dictionary)
+    {
+        playdate->system->realloc(prv->dictionary, 0);
+        he_memory_free(HEMemoryMetadata, prv->dictionarySize);
+    }
+    
+    playdate->system->realloc(loader, 0);
+    he_memory_free(HEMemoryMetadata, sizeof(HEBitmapTableLoader));
+}
+
+HEBitmapTable* HEBitmapTable_endLoad(HEBitmapTableLoader *loader)
+{
+    if(!loader)
+    {
+        return NULL;
+    }
+    
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    // Load the remaining bitmaps
+    while(!prv->failed && loader->loadedCount < loader->length)
+    {
+        if(!HEBitmapTableLoader_next(loader))
+        {
+            prv->failed = 1;
+        }
+    }
     
-    if(!valid)
+    if(prv->failed)
     {
-        HEBitmapTable_free(bitmapTable);
+        HEBitmapTable_cancelLoad(loader);
         return NULL;
     }
     
+    HEBitmapTable *bitmapTable = prv->bitmapTable;
+    
+    if(prv->retainBuffer && !prv->staticBuffer)
+    {
+        bitmapTable->prv.rawBuffer = prv->reader.rawBuffer;
+        bitmapTable->prv.rawBufferSize = prv->reader.buffer_len;
+    }
+    
+    HEBitmapTableLoader_free(loader);
+    
     return bitmapTable;
 }
 
-HEBitmapTable* HEBitmapTable_loadHEBT(const char *filename)
+void HEBitmapTable_cancelLoad(HEBitmapTableLoader *loader)
 {
-    return HEBitmapTable_loadHEBT_options(filename, 1);
+    _HEBitmapTableLoader *prv = &loader->prv;
+    
+    HEBitmapTable_free(prv->bitmapTable);
+    
+    prv->retainBuffer = 0;
+    HEBitmapTableLoader_free(loader);
 }
 
-HEBitmapTable* HEBitmapTable_loadHEBT_options(const char *filename, int useAllocator)
+//
+// Reader
+//
+static _HEReader HEReader_zero(void)
+{
+    return (_HEReader){
+        .buffer = NULL,
+        .buffer_ptr = NULL,
+        .buffer_len = 0,
+        .rawBuffer = NULL,
+        .overrun = 0,
+        .file = NULL,
+        .chunk = NULL,
+        .chunk_offset = 0,
+        .chunk_len = 0,
+        .chunk_pos = 0,
+        .dictionary = NULL,
+        .dictionary_len = 0
+    };
+}
+
+static int HEReader_openFile(_HEReader *reader, const char *filename)
 {
+    *reader = HEReader_zero();
+    
     SDFile *file = playdate->file->open(filename, kFileRead);
     if(!file)
     {
-        return NULL;
+        return 0;
     }
     
-    playdate->file->seek(file, 0, SEEK_END);
-    unsigned int file_size = playdate->file->tell(file);
-    playdate->file->seek(file, 0, SEEK_SET);
-
-    uint8_t *buffer = playdate->system->realloc(NULL, file_size);
-    if(buffer)
+    reader->chunk = playdate->system->realloc(NULL, HE_READER_CHUNK_SIZE);
+    if(!reader->chunk)
     {
-        playdate->file->read(file, buffer, file_size);
+        allocation_failed();
+        playdate->file->close(file);
+        return 0;
     }
-    playdate->file->close(file);
+    he_memory_alloc(HEMemoryMetadata, HE_READER_CHUNK_SIZE);
+    
+    reader->file = file;
+    
+    return 1;
+}
+
+static size_t HEReader_fileSize(_HEReader *reader)
+{
+    // Called before reading, the file is rewound
+    playdate->file->seek(reader->file, 0, SEEK_END);
+    int file_size = playdate->file->tell(reader->file);
+    playdate->file->seek(reader->file, 0, SEEK_SET);
+    
+    return (file_size > 0) ? file_size : 0;
+}
+
+static int HEReader_toBuffer(_HEReader *reader)
+{
+    size_t file_size = HEReader_fileSize(reader);
     
+    uint8_t *buffer = playdate->system->realloc(NULL, file_size);
     if(!buffer)
     {
         allocation_failed();
-        return NULL;
+        return 0;
     }
+    he_memory_alloc(HEMemoryRawBuffers, file_size);
     
-    HEBitmapTable *bitmapTable = HEBitmapTable_base();
-    _HEBitmapTable *prv = &bitmapTable->prv;
+    int read_len = playdate->file->read(reader->file, buffer, file_size);
+    if(read_len < 0 || (size_t)read_len != file_size)
+    {
+        playdate->system->realloc(buffer, 0);
+        he_memory_free(HEMemoryRawBuffers, file_size);
+        return 0;
+    }
     
-    uint8_t *buffer_ptr = buffer;
+    HEReader_close(reader);
     
-    // Read version
-    uint32_t version = read_uint32(&buffer_ptr);
+    reader->buffer = buffer;
+    reader->buffer_ptr = buffer;
+    reader->buffer_len = file_size;
+    reader->rawBuffer = buffer;
     
-    uint32_t length = read_uint32(&buffer_ptr);
-    bitmapTable->length = length;
+    return 1;
+}
+
+static void HEReader_close(_HEReader *reader)
+{
+    if(reader->file)
+    {
+        playdate->file->close(reader->file);
+        reader->file = NULL;
+    }
     
-    HEBitmapAllocator_alloc_bitmaps(&prv->allocator, length);
+    if(reader->chunk)
+    {
+        playdate->system->realloc(reader->chunk, 0);
+        he_memory_free(HEMemoryMetadata, HE_READER_CHUNK_SIZE);
+        reader->chunk = NULL;
+    }
+}
+
+static void HEReader_fill(_HEReader *reader)
+{
+    reader->chunk_offset += reader->chunk_len;
+    reader->chunk_pos = 0;
     
-    int compressed = 0;
-    if(version >= 3)
+    int len = playdate->file->read(reader->file, reader->chunk, HE_READER_CHUNK_SIZE);
+    reader->chunk_len = (len > 0) ? len : 0;
+}
+
+static int HEReader_check(_HEReader *reader, size_t len)
+{
+    // Reads past the end of the buffer stop at the end
+    if(len > (reader->buffer_len - (reader->buffer_ptr - reader->buffer)))
     {
-        // Version 3 supports compression
-        compressed = read_uint8(&buffer_ptr);
-        
-        if(version >= 4 && compressed)
+        reader->buffer_ptr = reader->buffer + reader->buffer_len;
+        reader->overrun = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static uint8_t HEReader_uint8(_HEReader *reader)
+{
+    if(!reader->file)
+    {
+        if(!HEReader_check(reader, 1))
         {
-            // Version 4 supports allocator
-            uint32_t allocator_data_len = read_uint32(&buffer_ptr);
-            if(useAllocator)
-            {
-                prv->allocator.data = playdate->system->realloc(NULL, allocator_data_len);
-                if(!prv->allocator.data)
-                {
-                    allocation_failed();
-                    HEBitmapTable_free(bitmapTable);
-                    return NULL;
-                }
-                prv->allocator.data_ptr = prv->allocator.data;
-            }
+            return 0;
         }
+        return *reader->buffer_ptr++;
     }
     
-    if(version >= 2)
+    if(reader->chunk_pos >= reader->chunk_len)
     {
-        // Version 2 supports padding
-        uint32_t padding_len = read_uint32(&buffer_ptr);
-        buffer_ptr += padding_len;
+        HEReader_fill(reader);
+        if(reader->chunk_len == 0)
+        {
+            // Unexpected end of file
+            reader->overrun = 1;
+            return 0;
+        }
     }
     
-    if(compressed && useAllocator && !prv->allocator.data)
+    return reader->chunk[reader->chunk_pos++];
+}
+
+static uint32_t HEReader_uint32(_HEReader *reader)
+{
+    if(!reader->file)
     {
-        // Compatibility mode
-        uint8_t *table_ptr = buffer_ptr;
-        size_t allocator_data_len = 0;
-        
-        for(uint32_t i = 0; i < length; i++)
-        {
-            uint32_t bitmap_size = read_uint32(&table_ptr);
-            uint8_t *bitmap_ptr = table_ptr;
-            
-            // Skip metadata
-            bitmap_ptr += 4; // version
-            bitmap_ptr += 4; // width
-            bitmap_ptr += 4; // height
-            bitmap_ptr += 4; // bx
-            bitmap_ptr += 4; // by
-            bitmap_ptr += 4; // bw
-            
-            int bh = read_uint32(&bitmap_ptr);
-            int rowbytes = read_uint32(&bitmap_ptr);
-            int hasMask = read_uint8(&bitmap_ptr);
-            
-            allocator_data_len += rowbytes * bh;
-            if(hasMask)
-            {
-                allocator_data_len += rowbytes * bh;
-            }
-            
-            table_ptr += bitmap_size;
-        }
-        
-        prv->allocator.data = playdate->system->realloc(NULL, allocator_data_len);
-        if(!prv->allocator.data)
+        if(!HEReader_check(reader, 4))
         {
-            allocation_failed();
-            HEBitmapTable_free(bitmapTable);
-            return NULL;
+            return 0;
         }
-        prv->allocator.data_ptr = prv->allocator.data;
+        uint32_t value = he_format_read_uint32(reader->buffer_ptr);
+        reader->buffer_ptr += 4;
+        return value;
     }
     
-    int retainBufferTable = 0;
-    
-    for(uint32_t i = 0; i < length; i++)
+    uint32_t value = (uint32_t)HEReader_uint8(reader) << 24;
+    value |= (uint32_t)HEReader_uint8(reader) << 16;
+    value |= (uint32_t)HEReader_uint8(reader) << 8;
+    value |= (uint32_t)HEReader_uint8(reader);
+    return value;
+}
+
+static size_t HEReader_tell(_HEReader *reader)
+{
+    if(!reader->file)
     {
-        uint32_t bitmap_size = read_uint32(&buffer_ptr);
-        
-        int retainBufferBitmap;
-        HEBitmap_fromBuffer(buffer_ptr, 0, &retainBufferBitmap, &prv->allocator, useAllocator);
-        
-        if(retainBufferBitmap){
-            retainBufferTable = 1;
+        return reader->buffer_ptr - reader->buffer;
+    }
+    return reader->chunk_offset + reader->chunk_pos;
+}
+
+static void HEReader_seek(_HEReader *reader, size_t position)
+{
+    if(!reader->file)
+    {
+        reader->buffer_ptr = reader->buffer;
+        if(HEReader_check(reader, position))
+        {
+            reader->buffer_ptr += position;
         }
-        buffer_ptr += bitmap_size;
     }
-    
-    if(retainBufferTable)
+    else if(position >= reader->chunk_offset && position <= (reader->chunk_offset + reader->chunk_len))
     {
-        prv->rawBuffer = buffer;
+        reader->chunk_pos = position - reader->chunk_offset;
     }
     else
     {
-        playdate->system->realloc(buffer, 0);
+        playdate->file->seek(reader->file, position, SEEK_SET);
+        reader->chunk_offset = position;
+        reader->chunk_len = 0;
+        reader->chunk_pos = 0;
     }
-    
-    return bitmapTable;
 }
 
-HEBitmap* HEBitmap_atIndex(HEBitmapTable *bitmapTable, unsigned int index)
+static void HEReader_skip(_HEReader *reader, size_t len)
 {
-    _HEBitmapTable *prv = &bitmapTable->prv;
-    
-    if(index < bitmapTable->length)
+    if(!reader->file)
     {
-        HEBitmap *bitmap = &prv->allocator.bitmaps[index];
-        return bitmap;
+        if(HEReader_check(reader, len))
+        {
+            reader->buffer_ptr += len;
+        }
+        return;
     }
-    
-    return NULL;
+    HEReader_seek(reader, HEReader_tell(reader) + len);
 }
 
-void HEBitmapTable_free(HEBitmapTable *bitmapTable)
+static void HEReader_read(_HEReader *reader, uint8_t *dst, size_t len)
 {
-    _HEBitmapTable *prv = &bitmapTable->prv;
+    if(!reader->file)
+    {
+        if(!HEReader_check(reader, len))
+        {
+            memset(dst, 0, len);
+            return;
+        }
+        memcpy(dst, reader->buffer_ptr, len);
+        reader->buffer_ptr += len;
+        return;
+    }
     
-    for(unsigned int i = 0; i < prv->allocator.bitmapsCount; i++)
+    while(len > 0)
     {
-        HEBitmap *bitmap = &prv->allocator.bitmaps[i];
-        _HEBitmap_free(bitmap);
+        if(reader->chunk_pos >= reader->chunk_len)
+        {
+            if(len >= HE_READER_CHUNK_SIZE)
+            {
+                // Read large blocks directly into the destination
+                reader->chunk_offset += reader->chunk_len;
+                reader->chunk_len = 0;
+                reader->chunk_pos = 0;
+                
+                int read_len = playdate->file->read(reader->file, dst, len);
+                if(read_len <= 0)
+                {
+                    break;
+                }
+                reader->chunk_offset += read_len;
+                dst += read_len;
+                len -= read_len;
+                continue;
+            }
+            
+            HEReader_fill(reader);
+            if(reader->chunk_len == 0)
+            {
+                break;
+            }
+        }
+        
+        size_t chunk_available = reader->chunk_len - reader->chunk_pos;
+        size_t copy_len = (len < chunk_available) ? len : chunk_available;
+        
+        memcpy(dst, reader->chunk + reader->chunk_pos, copy_len);
+        reader->chunk_pos += copy_len;
+        dst += copy_len;
+        len -= copy_len;
     }
     
-    if(prv->rawBuffer)
+    if(len > 0)
     {
-        playdate->system->realloc(prv->rawBuffer, 0);
+        // Unexpected end of file
+        memset(dst, 0, len);
+        reader->overrun = 1;
+    }
+}
+
+static void HEReader_decompress(_HEReader *reader, uint8_t *dst, size_t len)
+{
+    if(!reader->file)
+    {
+        size_t available = reader->buffer_len - (reader->buffer_ptr - reader->buffer);
+        size_t read_len = he_format_decompress(dst, len, reader->buffer_ptr, available);
+        if(HEReader_check(reader, read_len))
+        {
+            reader->buffer_ptr += read_len;
+        }
+        return;
     }
     
-    HEBitmapAllocator_free(&prv->allocator);
+    size_t i = 0;
     
-    playdate->system->realloc(bitmapTable, 0);
+    while(i < len)
+    {
+        uint8_t count = HEReader_uint8(reader);
+        uint8_t data = HEReader_uint8(reader);
+        size_t end = i + count;
+        if(end > len)
+        {
+            end = len;
+        }
+        memset(dst + i, data, end - i);
+        i = end;
+        
+        if(reader->overrun)
+        {
+            // Unexpected end of file
+            memset(dst + i, 0, len - i);
+            break;
+        }
+    }
 }
 
-static uint8_t read_uint8(uint8_t **buffer_ptr)
+static size_t HEReader_lzLength(_HEReader *reader, size_t len)
 {
-    uint8_t *buffer = *buffer_ptr;
-    uint8_t value = buffer[0];
-    *buffer_ptr += 1;
-    return value;
+    if(len == 15)
+    {
+        // Extended length
+        uint8_t value;
+        do
+        {
+            value = HEReader_uint8(reader);
+            len += value;
+        } while(value == 255);
+    }
+    return len;
 }
 
-static uint32_t read_uint32(uint8_t **buffer_ptr)
+static void HEReader_lzDecompress(_HEReader *reader, uint8_t *dst, size_t len)
 {
-    uint8_t *buffer = *buffer_ptr;
-    uint32_t value = (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 | (uint32_t)buffer[2] << 8 | (uint32_t)buffer[3];
-    *buffer_ptr += 4;
-    return value;
+    if(!reader->file)
+    {
+        size_t available = reader->buffer_len - (reader->buffer_ptr - reader->buffer);
+        size_t read_len = he_format_lz_decompress(dst, len, reader->buffer_ptr, available, reader->dictionary, reader->dictionary_len);
+        if(HEReader_check(reader, read_len))
+        {
+            reader->buffer_ptr += read_len;
+        }
+        return;
+    }
+    
+    size_t i = 0;
+    
+    while(i < len)
+    {
+        uint8_t token = HEReader_uint8(reader);
+        
+        size_t literals = HEReader_lzLength(reader, token >> 4);
+        if(literals > (len - i))
+        {
+            literals = len - i;
+        }
+        HEReader_read(reader, dst + i, literals);
+        i += literals;
+        
+        if(i >= len)
+        {
+            break;
+        }
+        
+        size_t offset = (size_t)HEReader_uint8(reader) << 8;
+        offset |= HEReader_uint8(reader);
+        
+        size_t match_len = HEReader_lzLength(reader, token & 0x0F) + HE_FORMAT_LZ_MIN_MATCH;
+        
+        if(reader->overrun)
+        {
+            // Unexpected end of file
+            memset(dst + i, 0, len - i);
+            break;
+        }
+        if(match_len > (len - i))
+        {
+            match_len = len - i;
+        }
+        
+        // Matches are copied from the output or the dictionary, not the file
+        he_format_lz_copy(dst, i, match_len, offset, reader->dictionary, reader->dictionary_len);
+        i += match_len;
+    }
+}
+
+static void HEReader_readData(_HEReader *reader, uint8_t *dst, size_t len, int compressed)
+{
+    if(compressed == HE_FORMAT_COMPRESSION_LZ)
+    {
+        HEReader_lzDecompress(reader, dst, len);
+    }
+    else if(compressed)
+    {
+        HEReader_decompress(reader, dst, len);
+    }
+    else
+    {
+        HEReader_read(reader, dst, len);
+    }
 }
 
 static void buffer_align_8_32(uint8_t *dst, uint8_t *src, int dst_rowbytes, int src_rowbytes, int x, int y, int width, int height, uint8_t fill_value)
@@ -685,11 +2415,11 @@ static void buffer_align_8_32(uint8_t *dst, uint8_t *src, int dst_rowbytes, int
 static void get_bounds(uint8_t *mask, int rowbytes, int width, int height, int *bx, int *by, int *bw, int *bh)
 {
     int min_y = 0; int min_x = 0; int max_x = width; int max_y = height;
-
+    
     if(mask)
     {
         int min_set = 0;
-
+        
         max_x = 0;
         max_y = 0;
         
@@ -736,8 +2466,10 @@ static _HEBitmapAllocator HEBitmapAllocator_zero(void)
     return (_HEBitmapAllocator){
         .bitmaps = NULL,
         .bitmapsCount = 0,
+        .bitmapsLength = 0,
         .data = NULL,
-        .data_ptr = NULL
+        .data_ptr = NULL,
+        .dataSize = 0
     };
 }
 
@@ -746,6 +2478,8 @@ static void HEBitmapAllocator_alloc_bitmaps(_HEBitmapAllocator *allocator, unsig
     if(length > 0)
     {
         allocator->bitmaps = playdate->system->realloc(NULL, length * sizeof(HEBitmap));
+        allocator->bitmapsLength = length;
+        he_memory_alloc(HEMemoryMetadata, length * sizeof(HEBitmap));
     }
 }
 
@@ -754,11 +2488,13 @@ static void HEBitmapAllocator_free(_HEBitmapAllocator *allocator)
     if(allocator->bitmaps)
     {
         playdate->system->realloc(allocator->bitmaps, 0);
+        he_memory_free(HEMemoryMetadata, allocator->bitmapsLength * sizeof(HEBitmap));
     }
     
     if(allocator->data)
     {
         playdate->system->realloc(allocator->data, 0);
+        he_memory_free(HEMemoryPlanes, allocator->dataSize);
     }
 }
 
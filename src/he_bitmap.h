@@ -9,6 +9,8 @@
 #define he_bitmap_h
 
 #include "pd_api.h"
+#include "he_foundation.h"
+#include "he_format.h"
 
 typedef struct {
     uint8_t *data;
@@ -19,8 +21,14 @@ typedef struct {
     int bw;
     int bh;
     uint8_t *rawBuffer;
+    size_t rawBufferSize;
     int hasMask;
+    int hasFill;
+    uint32_t fill;
     int isOwner;
+    int isShared;
+    // Cache key of shared bitmaps
+    uint32_t sharedHash;
     int freeData;
     int freeSelf;
 } _HEBitmap;
@@ -34,13 +42,41 @@ typedef struct HEBitmap {
 typedef struct {
     HEBitmap *bitmaps;
     unsigned int bitmapsCount;
+    unsigned int bitmapsLength;
     uint8_t *data;
     uint8_t *data_ptr;
+    size_t dataSize;
 } _HEBitmapAllocator;
 
+typedef struct {
+    uint32_t offset;
+    uint32_t len;
+    uint8_t *data;
+} _HEDeltaRun;
+
+typedef struct {
+    _HEDeltaRun *runs;
+    unsigned int runsCount;
+    size_t runsSize;
+    int isDelta;
+} _HEBitmapDelta;
+
 typedef struct {
     _HEBitmapAllocator allocator;
     uint8_t *rawBuffer;
+    size_t rawBufferSize;
+    _HEBitmapDelta *deltas;
+    uint8_t *playbackData;
+    size_t playbackSize;
+    int playbackIndex;
+    unsigned int nextFrame;
+    int lastFrame;
+    int lastX;
+    int lastY;
+    HERect lastClipRect;
+    uint8_t *lastTarget;
+    int isShared;
+    uint32_t sharedHash;
 } _HEBitmapTable;
 
 typedef struct HEBitmapTable {
@@ -48,17 +84,106 @@ typedef struct HEBitmapTable {
     unsigned int length;
 } HEBitmapTable;
 
+typedef struct {
+    const uint8_t *buffer;
+    const uint8_t *buffer_ptr;
+    size_t buffer_len;
+    // Buffer read from the file, NULL for memory
+    uint8_t *rawBuffer;
+    // Read past the end of the buffer
+    int overrun;
+    SDFile *file;
+    uint8_t *chunk;
+    size_t chunk_offset;
+    size_t chunk_len;
+    size_t chunk_pos;
+    const uint8_t *dictionary;
+    size_t dictionary_len;
+} _HEReader;
+
+typedef struct {
+    HEBitmapTable *bitmapTable;
+    LCDBitmapTable *lcd_bitmapTable;
+    _HEReader reader;
+    HEFormatFrameIndex *frameIndex;
+    size_t frameIndexSize;
+    uint8_t *dictionary;
+    size_t dictionarySize;
+    unsigned int firstFrame;
+    // Keyframe decoded into the first frame of a range
+    unsigned int keyFrame;
+    int freeLCDBitmapTable;
+    int retainBuffer;
+    int staticBuffer;
+    int useAllocator;
+    int failed;
+} _HEBitmapTableLoader;
+
+typedef struct {
+    size_t planes;
+    size_t rawBuffers;
+    size_t metadata;
+    size_t total;
+} HEMemoryUsage;
+
+typedef struct {
+    uint8_t *buffer;
+    size_t bufferSize;
+    // NULL for the display frame
+    uint8_t *frame;
+    int width;
+    int height;
+    int rowbytes;
+    // Saved frame words
+    int word;
+    int y;
+    int words;
+    int rows;
+} _HESaveUnder;
+
+typedef struct HESaveUnder {
+    _HESaveUnder prv;
+} HESaveUnder;
+
+typedef struct HEBitmapTableLoader {
+    _HEBitmapTableLoader prv;
+    unsigned int length;
+    unsigned int loadedCount;
+} HEBitmapTableLoader;
+
 //
 // Bitmap
 //
 HEBitmap* HEBitmap_load(const char *filename);
 HEBitmap* HEBitmap_fromLCDBitmap(LCDBitmap *lcd_bitmap);
 HEBitmap* HEBitmap_loadHEB(const char *filename);
+// HEB data in memory (see encoder.py --c-array), must outlive the bitmap.
+// Raw planes are drawn in place: bytes must be 32-byte aligned and readable 4 bytes past len
+// (kernel look-ahead), the --c-array header provides both. Returns NULL for truncated or invalid data
+HEBitmap* HEBitmap_fromMemory(const uint8_t *bytes, size_t len);
 void HEBitmap_draw(HEBitmap *bitmap, int x, int y);
+// Draws in the frame and clip rect of context
+void HEBitmap_drawInContext(HEBitmap *bitmap, int x, int y, HEGraphicsContext *context);
 LCDColor HEBitmap_colorAt(HEBitmap *bitmap, int x, int y);
+// data is NULL for single color bitmaps (mask only), see HEBitmap_getFill
 void HEBitmap_getData(HEBitmap *bitmap, uint8_t **data, uint8_t **mask, int *rowbytes, int *bx, int *by, int *bw, int *bh);
+// Returns 1 and the color of the visible pixels (kColorBlack or kColorWhite) if the bitmap has no data plane
+int HEBitmap_getFill(HEBitmap *bitmap, LCDColor *color);
+// Heap owned by the bitmap, shared frames and memory data are not counted
+HEMemoryUsage HEBitmap_memoryUsage(HEBitmap *bitmap);
 void HEBitmap_free(HEBitmap *bitmap);
 
+//
+// Bitmap (save-under)
+//
+HESaveUnder* HESaveUnder_new(void);
+// Copies the frame words under the clipped bitmap to saveUnder, then draws it
+void HEBitmap_drawSaved(HEBitmap *bitmap, int x, int y, HESaveUnder *saveUnder);
+void HEBitmap_drawSavedInContext(HEBitmap *bitmap, int x, int y, HESaveUnder *saveUnder, HEGraphicsContext *context);
+// Puts the saved words back, overlapping sprites are restored in reverse draw order
+void HEBitmap_restore(HESaveUnder *saveUnder);
+void HESaveUnder_free(HESaveUnder *saveUnder);
+
 //
 // Bitmap table
 //
@@ -66,7 +191,35 @@ HEBitmapTable* HEBitmapTable_load(const char *filename);
 HEBitmapTable* HEBitmapTable_fromLCDBitmapTable(LCDBitmapTable *lcd_bitmapTable);
 HEBitmapTable* HEBitmapTable_loadHEBT(const char *filename);
 HEBitmapTable* HEBitmapTable_loadHEBT_options(const char *filename, int useAllocator);
+// Loads count frames starting at first (version 8 files)
+HEBitmapTable* HEBitmapTable_loadHEBT_range(const char *filename, unsigned int first, unsigned int count);
+// HEBT data in memory, must outlive the table. Same requirements as HEBitmap_fromMemory
+HEBitmapTable* HEBitmapTable_fromMemory(const uint8_t *bytes, size_t len);
+// Delta frames share a playback buffer, data is valid until the next delta frame is requested
 HEBitmap* HEBitmap_atIndex(HEBitmapTable *bitmapTable, unsigned int index);
+HEMemoryUsage HEBitmapTable_memoryUsage(HEBitmapTable *bitmapTable);
 void HEBitmapTable_free(HEBitmapTable *bitmapTable);
 
+//
+// Bitmap table (sequential playback)
+//
+void HEBitmapTable_drawNextFrame(HEBitmapTable *bitmapTable, int x, int y);
+void HEBitmapTable_drawNextFrameInContext(HEBitmapTable *bitmapTable, int x, int y, HEGraphicsContext *context);
+void HEBitmapTable_setNextFrame(HEBitmapTable *bitmapTable, unsigned int index);
+unsigned int HEBitmapTable_getNextFrame(HEBitmapTable *bitmapTable);
+// Call when the framebuffer has been cleared or drawn over
+void HEBitmapTable_invalidatePlayback(HEBitmapTable *bitmapTable);
+
+//
+// Bitmap table (incremental loading)
+//
+HEBitmapTableLoader* HEBitmapTable_beginLoad(const char *filename);
+HEBitmapTableLoader* HEBitmapTable_beginLoadHEBT(const char *filename);
+HEBitmapTableLoader* HEBitmapTable_beginLoadHEBT_options(const char *filename, int useAllocator);
+HEBitmapTableLoader* HEBitmapTable_beginLoadHEBT_range(const char *filename, unsigned int first, unsigned int count);
+int HEBitmapTable_loadStep(HEBitmapTableLoader *loader, unsigned int budget_ms);
+float HEBitmapTable_loadProgress(HEBitmapTableLoader *loader);
+HEBitmapTable* HEBitmapTable_endLoad(HEBitmapTableLoader *loader);
+void HEBitmapTable_cancelLoad(HEBitmapTableLoader *loader);
+
 #endif /* he_bitmap_h */
@@ -8,11 +8,14 @@
 #include "pd_api.h"
 #include "he_api.h"
 #include "he_prv.h"
+#include "he_bitmap_simd.h"
 
-#ifdef HE_BITMAP_MASK
-void HEBitmap_drawMask(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
+#if defined(HE_BITMAP_FILL)
+void HEBitmap_drawFill(PlaydateAPI *playdate, HEGraphicsContext *context, HEBitmap *bitmap, int x, int y)
+#elif defined(HE_BITMAP_MASK)
+void HEBitmap_drawMask(PlaydateAPI *playdate, HEGraphicsContext *context, HEBitmap *bitmap, int x, int y)
 #else
-void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
+void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEGraphicsContext *context, HEBitmap *bitmap, int x, int y)
 #endif
 {
     _HEBitmap *prv = &bitmap->prv;
@@ -20,20 +23,46 @@ void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
     x += prv->bx;
     y += prv->by;
     
-    HERect clipRect = he_graphics_context->clipRect;
+    HERect clipRect = context->clipRect;
     
     if((x + prv->bw) <= clipRect.x || x >= (clipRect.x + clipRect.width) || (y + prv->bh) <= clipRect.y || y >= (clipRect.y + clipRect.height))
     {
         //
         // Bitmap is not visible
         //
+        HE_STATS_ADD(culledDraws, 1);
         return;
     }
+
+#if HE_STATS
+    float start_time = playdate->system->getElapsedTime();
+#endif
     
     unsigned int x1, y1, x2, y2, offset_left, offset_top;
     he_bitmap_clip_bounds(bitmap, x, y, &x1, &y1, &x2, &y2, &offset_left, &offset_top, clipRect);
+
+#if HE_STATS
+#if defined(HE_BITMAP_FILL)
+    HE_STATS_ADD(fillDraws, 1);
+#elif defined(HE_BITMAP_MASK)
+    HE_STATS_ADD(maskDraws, 1);
+#else
+    HE_STATS_ADD(opaqueDraws, 1);
+#endif
+    if(offset_left > 0 || offset_top > 0 || (int)x2 < (x + prv->bw) || (int)y2 < (y + prv->bh))
+    {
+        HE_STATS_ADD(clippedDraws, 1);
+    }
+    HE_STATS_ADD(rows, y2 - y1);
+    HE_STATS_ADD(words, (y2 - y1) * ((x2 - x1 / 32 * 32 + 31) / 32));
+#endif
     
-    uint8_t *frame_start = playdate->graphics->getFrame() + y1 * LCD_ROWSIZE + x1 / 32 * 4;
+    uint8_t *frame_start = he_graphics_frame(context) + y1 * context->rowbytes + x1 / 32 * 4;
+
+#ifdef HE_BITMAP_FILL
+    // Mask-only bitmap, visible pixels have the same color
+    uint32_t fill = prv->fill;
+#endif
     
     if((int)(x1 / 32 * 32) <= x)
     {
@@ -50,16 +79,20 @@ void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
         uint32_t og_shift_mask = ~(0xFFFFFFFF >> shift);
         
         int data_offset = offset_top * prv->rowbytes;
-        
+
+#ifndef HE_BITMAP_FILL
         uint8_t *data_start = prv->data + data_offset;
+#endif
 #ifdef HE_BITMAP_MASK
         uint8_t *mask_start = prv->mask + data_offset;
 #endif
         for(int row = y1; row < y2; row++)
         {
             uint32_t *frame_ptr = (uint32_t*)frame_start;
+#ifndef HE_BITMAP_FILL
             uint32_t *data_ptr = (uint32_t*)data_start;
             uint32_t data_left = bswap32(*frame_ptr);
+#endif
 #ifdef HE_BITMAP_MASK
             uint32_t *mask_ptr = (uint32_t*)mask_start;
             uint32_t mask_left = 0x00000000;
@@ -69,8 +102,12 @@ void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
             
             while(len > 0)
             {
+#ifdef HE_BITMAP_FILL
+                uint32_t data = fill;
+#else
                 uint32_t data_right = bswap32(*data_ptr) >> shift;
                 uint32_t data = (data_left & shift_mask) | (data_right & ~shift_mask);
+#endif
 #ifdef HE_BITMAP_MASK
                 uint32_t mask_right = bswap32(*mask_ptr) >> shift;
                 uint32_t mask = (mask_left & shift_mask) | (mask_right & ~shift_mask);
@@ -83,19 +120,46 @@ void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
                 }
                 
                 *frame_ptr++ = bswap32(data);
-                
+
+#ifndef HE_BITMAP_FILL
                 // Fetch data for next iteration
                 data_left = bswap32(*data_ptr++) << (32 - shift);
+#endif
 #ifdef HE_BITMAP_MASK
                 // Fetch mask for next iteration
                 mask_left = bswap32(*mask_ptr++) << (32 - shift);
 #endif
                 shift_mask = og_shift_mask;
                 len -= 32;
+#ifdef HE_SIMD_WORDS
+                if(len >= (32 * HE_SIMD_WORDS))
+                {
+                    // Full words of the row, data_ptr - 1 is the left word
+#if defined(HE_BITMAP_FILL)
+                    int simd_words = he_simd_row_fill(frame_ptr, mask_ptr - 1, len / 32, 32 - shift, fill);
+#elif defined(HE_BITMAP_MASK)
+                    int simd_words = he_simd_row_mask(frame_ptr, data_ptr - 1, mask_ptr - 1, len / 32, 32 - shift);
+#else
+                    int simd_words = he_simd_row_opaque(frame_ptr, data_ptr - 1, len / 32, 32 - shift);
+#endif
+#ifdef HE_BITMAP_MASK
+                    mask_ptr += simd_words;
+                    mask_left = shift > 0 ? (bswap32(*(mask_ptr - 1)) << (32 - shift)) : 0x00000000;
+#endif
+                    frame_ptr += simd_words;
+#ifndef HE_BITMAP_FILL
+                    data_ptr += simd_words;
+                    data_left = shift > 0 ? (bswap32(*(data_ptr - 1)) << (32 - shift)) : 0x00000000;
+#endif
+                    len -= simd_words * 32;
+                }
+#endif
             }
             
-            frame_start += LCD_ROWSIZE;
+            frame_start += context->rowbytes;
+#ifndef HE_BITMAP_FILL
             data_start += prv->rowbytes;
+#endif
 #ifdef HE_BITMAP_MASK
             mask_start += prv->rowbytes;
 #endif
@@ -129,19 +193,23 @@ void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
             shift = 32 - shift;
         }
         uint32_t shift_mask = 0xFFFFFFFF << shift;
-
+        
         unsigned int offset_32 = x1 / 32 * 32 - x;
         int data_offset = offset_top * prv->rowbytes + offset_32 / 32 * 4;
-        
+
+#ifndef HE_BITMAP_FILL
         uint8_t *data_start = prv->data + data_offset;
+#endif
 #ifdef HE_BITMAP_MASK
         uint8_t *mask_start = prv->mask + data_offset;
 #endif
         for(int row = y1; row < y2; row++)
         {
             uint32_t *frame_ptr = (uint32_t*)frame_start;
+#ifndef HE_BITMAP_FILL
             uint32_t *data_ptr = (uint32_t*)data_start;
             uint32_t data_left = bswap32(*data_ptr) << shift;
+#endif
 #ifdef HE_BITMAP_MASK
             uint32_t *mask_ptr = (uint32_t*)mask_start;
             uint32_t mask_left = bswap32(*mask_ptr) << shift;
@@ -151,8 +219,12 @@ void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
             
             while(len > 0)
             {
+#ifdef HE_BITMAP_FILL
+                uint32_t data = fill;
+#else
                 uint32_t data_right = ((len + shift) > 32) ? (bswap32(*++data_ptr) >> (32 - shift)) : bswap32(*frame_ptr);
                 uint32_t data = (data_left & shift_mask) | (data_right & ~shift_mask);
+#endif
 #ifdef HE_BITMAP_MASK
                 uint32_t mask_right = ((len + shift) > 32) ? (bswap32(*++mask_ptr) >> (32 - shift)) : 0x00000000;
                 uint32_t mask = (mask_left & shift_mask) | (mask_right & ~shift_mask);
@@ -171,23 +243,54 @@ void HEBitmap_drawOpaque(PlaydateAPI *playdate, HEBitmap *bitmap, int x, int y)
                 }
                 
                 *frame_ptr++ = bswap32(data);
-                
+
+#ifndef HE_BITMAP_FILL
                 // Fetch data for next iteration
                 data_left = bswap32(*data_ptr) << shift;
+#endif
 #ifdef HE_BITMAP_MASK
                 // Fetch mask for next iteration
                 mask_left = bswap32(*mask_ptr) << shift;
 #endif
                 len -= 32;
+#ifdef HE_SIMD_WORDS
+                if(len > (32 * HE_SIMD_WORDS))
+                {
+                    // Full words of the row, the last word is left to the scalar path
+#if defined(HE_BITMAP_FILL)
+                    int simd_words = he_simd_row_fill(frame_ptr, mask_ptr, (len - 1) / 32, shift, fill);
+#elif defined(HE_BITMAP_MASK)
+                    int simd_words = he_simd_row_mask(frame_ptr, data_ptr, mask_ptr, (len - 1) / 32, shift);
+#else
+                    int simd_words = he_simd_row_opaque(frame_ptr, data_ptr, (len - 1) / 32, shift);
+#endif
+#ifdef HE_BITMAP_MASK
+                    mask_ptr += simd_words;
+                    mask_left = bswap32(*mask_ptr) << shift;
+#endif
+                    frame_ptr += simd_words;
+#ifndef HE_BITMAP_FILL
+                    data_ptr += simd_words;
+                    data_left = bswap32(*data_ptr) << shift;
+#endif
+                    len -= simd_words * 32;
+                }
+#endif
             }
-
-            frame_start += LCD_ROWSIZE;
+            
+            frame_start += context->rowbytes;
+#ifndef HE_BITMAP_FILL
             data_start += prv->rowbytes;
+#endif
 #ifdef HE_BITMAP_MASK
             mask_start += prv->rowbytes;
 #endif
         }
     }
     
-    playdate->graphics->markUpdatedRows(y1, y2 - 1);
+    he_graphics_markUpdatedRows(context, y1, y2 - 1);
+
+#if HE_STATS
+    HE_STATS_ADD(kernelTime, playdate->system->getElapsedTime() - start_time);
+#endif
 }
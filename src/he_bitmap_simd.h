@@ -0,0 +1,219 @@
+//
+//  he_bitmap_simd.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef he_bitmap_simd_h
+#define he_bitmap_simd_h
+
+#include <stdint.h>
+
+//
+// Vector kernels for simulator and host builds (SSE2, AVX2, NEON)
+// Define HE_NO_SIMD to use the scalar kernel only
+//
+// Each output word is built from two consecutive source words:
+// frame[i] = bswap32((bswap32(src[i]) << shift) | (bswap32(src[i + 1]) >> (32 - shift)))
+// with 0 <= shift <= 32 (a shift of 32 yields zero bits)
+//
+#if !defined(HE_NO_SIMD) && !TARGET_PLAYDATE
+#if defined(__AVX2__)
+#define HE_SIMD_WORDS 8
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define HE_SIMD_WORDS 4
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define HE_SIMD_WORDS 4
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(HE_SIMD_WORDS) && defined(__AVX2__)
+
+static inline __m256i he_simd_bswap32(__m256i v)
+{
+    const __m256i bswap_mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm256_shuffle_epi8(v, bswap_mask);
+}
+
+static inline __m256i he_simd_shift_merge(const uint32_t *src, __m128i left_shift, __m128i right_shift)
+{
+    __m256i left = he_simd_bswap32(_mm256_loadu_si256((const __m256i*)src));
+    __m256i right = he_simd_bswap32(_mm256_loadu_si256((const __m256i*)(src + 1)));
+    return he_simd_bswap32(_mm256_or_si256(_mm256_sll_epi32(left, left_shift), _mm256_srl_epi32(right, right_shift)));
+}
+
+static inline int he_simd_row_opaque(uint32_t *frame, const uint32_t *data, int words, unsigned int shift)
+{
+    __m128i left_shift = _mm_cvtsi32_si128(shift);
+    __m128i right_shift = _mm_cvtsi32_si128(32 - shift);
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        _mm256_storeu_si256((__m256i*)(frame + i), he_simd_shift_merge(data + i, left_shift, right_shift));
+    }
+    return i;
+}
+
+static inline int he_simd_row_mask(uint32_t *frame, const uint32_t *data, const uint32_t *mask, int words, unsigned int shift)
+{
+    __m128i left_shift = _mm_cvtsi32_si128(shift);
+    __m128i right_shift = _mm_cvtsi32_si128(32 - shift);
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        __m256i data_v = he_simd_shift_merge(data + i, left_shift, right_shift);
+        __m256i mask_v = he_simd_shift_merge(mask + i, left_shift, right_shift);
+        __m256i frame_v = _mm256_loadu_si256((const __m256i*)(frame + i));
+        _mm256_storeu_si256((__m256i*)(frame + i), _mm256_or_si256(_mm256_andnot_si256(mask_v, frame_v), _mm256_and_si256(data_v, mask_v)));
+    }
+    return i;
+}
+
+static inline int he_simd_row_fill(uint32_t *frame, const uint32_t *mask, int words, unsigned int shift, uint32_t fill)
+{
+    __m128i left_shift = _mm_cvtsi32_si128(shift);
+    __m128i right_shift = _mm_cvtsi32_si128(32 - shift);
+    __m256i fill_v = _mm256_set1_epi32((int)fill);
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        __m256i mask_v = he_simd_shift_merge(mask + i, left_shift, right_shift);
+        __m256i frame_v = _mm256_loadu_si256((const __m256i*)(frame + i));
+        _mm256_storeu_si256((__m256i*)(frame + i), _mm256_or_si256(_mm256_andnot_si256(mask_v, frame_v), _mm256_and_si256(fill_v, mask_v)));
+    }
+    return i;
+}
+
+#elif defined(HE_SIMD_WORDS) && (defined(__SSE2__) || defined(_M_X64))
+
+static inline __m128i he_simd_bswap32(__m128i v)
+{
+    // Swap bytes in each 16-bit half, then swap the halves
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline __m128i he_simd_shift_merge(const uint32_t *src, __m128i left_shift, __m128i right_shift)
+{
+    __m128i left = he_simd_bswap32(_mm_loadu_si128((const __m128i*)src));
+    __m128i right = he_simd_bswap32(_mm_loadu_si128((const __m128i*)(src + 1)));
+    return he_simd_bswap32(_mm_or_si128(_mm_sll_epi32(left, left_shift), _mm_srl_epi32(right, right_shift)));
+}
+
+static inline int he_simd_row_opaque(uint32_t *frame, const uint32_t *data, int words, unsigned int shift)
+{
+    __m128i left_shift = _mm_cvtsi32_si128(shift);
+    __m128i right_shift = _mm_cvtsi32_si128(32 - shift);
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        _mm_storeu_si128((__m128i*)(frame + i), he_simd_shift_merge(data + i, left_shift, right_shift));
+    }
+    return i;
+}
+
+static inline int he_simd_row_mask(uint32_t *frame, const uint32_t *data, const uint32_t *mask, int words, unsigned int shift)
+{
+    __m128i left_shift = _mm_cvtsi32_si128(shift);
+    __m128i right_shift = _mm_cvtsi32_si128(32 - shift);
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        __m128i data_v = he_simd_shift_merge(data + i, left_shift, right_shift);
+        __m128i mask_v = he_simd_shift_merge(mask + i, left_shift, right_shift);
+        __m128i frame_v = _mm_loadu_si128((const __m128i*)(frame + i));
+        _mm_storeu_si128((__m128i*)(frame + i), _mm_or_si128(_mm_andnot_si128(mask_v, frame_v), _mm_and_si128(data_v, mask_v)));
+    }
+    return i;
+}
+
+static inline int he_simd_row_fill(uint32_t *frame, const uint32_t *mask, int words, unsigned int shift, uint32_t fill)
+{
+    __m128i left_shift = _mm_cvtsi32_si128(shift);
+    __m128i right_shift = _mm_cvtsi32_si128(32 - shift);
+    __m128i fill_v = _mm_set1_epi32((int)fill);
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        __m128i mask_v = he_simd_shift_merge(mask + i, left_shift, right_shift);
+        __m128i frame_v = _mm_loadu_si128((const __m128i*)(frame + i));
+        _mm_storeu_si128((__m128i*)(frame + i), _mm_or_si128(_mm_andnot_si128(mask_v, frame_v), _mm_and_si128(fill_v, mask_v)));
+    }
+    return i;
+}
+
+#elif defined(HE_SIMD_WORDS) && defined(__ARM_NEON)
+
+static inline uint32x4_t he_simd_bswap32(uint32x4_t v)
+{
+    return vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(v)));
+}
+
+static inline uint32x4_t he_simd_shift_merge(const uint32_t *src, int32x4_t left_shift, int32x4_t right_shift)
+{
+    uint32x4_t left = he_simd_bswap32(vld1q_u32(src));
+    uint32x4_t right = he_simd_bswap32(vld1q_u32(src + 1));
+    return he_simd_bswap32(vorrq_u32(vshlq_u32(left, left_shift), vshlq_u32(right, right_shift)));
+}
+
+static inline int he_simd_row_opaque(uint32_t *frame, const uint32_t *data, int words, unsigned int shift)
+{
+    // Negative shifts are right shifts
+    int32x4_t left_shift = vdupq_n_s32((int32_t)shift);
+    int32x4_t right_shift = vdupq_n_s32(-(int32_t)(32 - shift));
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        vst1q_u32(frame + i, he_simd_shift_merge(data + i, left_shift, right_shift));
+    }
+    return i;
+}
+
+static inline int he_simd_row_mask(uint32_t *frame, const uint32_t *data, const uint32_t *mask, int words, unsigned int shift)
+{
+    int32x4_t left_shift = vdupq_n_s32((int32_t)shift);
+    int32x4_t right_shift = vdupq_n_s32(-(int32_t)(32 - shift));
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        uint32x4_t data_v = he_simd_shift_merge(data + i, left_shift, right_shift);
+        uint32x4_t mask_v = he_simd_shift_merge(mask + i, left_shift, right_shift);
+        uint32x4_t frame_v = vld1q_u32(frame + i);
+        vst1q_u32(frame + i, vbslq_u32(mask_v, data_v, frame_v));
+    }
+    return i;
+}
+
+static inline int he_simd_row_fill(uint32_t *frame, const uint32_t *mask, int words, unsigned int shift, uint32_t fill)
+{
+    int32x4_t left_shift = vdupq_n_s32((int32_t)shift);
+    int32x4_t right_shift = vdupq_n_s32(-(int32_t)(32 - shift));
+    uint32x4_t fill_v = vdupq_n_u32(fill);
+    
+    int i = 0;
+    for(; (i + HE_SIMD_WORDS) <= words; i += HE_SIMD_WORDS)
+    {
+        uint32x4_t mask_v = he_simd_shift_merge(mask + i, left_shift, right_shift);
+        uint32x4_t frame_v = vld1q_u32(frame + i);
+        vst1q_u32(frame + i, vbslq_u32(mask_v, fill_v, frame_v));
+    }
+    return i;
+}
+
+#endif
+
+#endif /* he_bitmap_simd_h */
@@ -0,0 +1,289 @@
+//
+//  he_cache.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <string.h>
+
+#include "he_api.h"
+#include "he_prv.h"
+
+#define HE_CACHE_MIN_CAPACITY 32
+
+static PlaydateAPI *playdate;
+
+static _HECacheEntry *cache_entries = NULL;
+static unsigned int cache_capacity = 0;
+static unsigned int cache_count = 0;
+
+static void* he_cache_load(const char *filename, int isTable);
+static _HECacheEntry* he_cache_find(const char *filename, uint32_t hash, int isTable);
+static void he_cache_remove(unsigned int index);
+static int he_cache_resize(unsigned int capacity);
+static uint32_t he_cache_hash(const char *filename, int isTable);
+static int has_extension(const char *filename, const char *extension);
+
+HEBitmap* HEBitmap_loadShared(const char *filename)
+{
+    return he_cache_load(filename, 0);
+}
+
+HEBitmapTable* HEBitmapTable_loadShared(const char *filename)
+{
+    return he_cache_load(filename, 1);
+}
+
+void he_cache_purgeUnused(void)
+{
+    unsigned int purged_count = 0;
+    
+    for(unsigned int i = 0; i < cache_capacity;)
+    {
+        _HECacheEntry *entry = &cache_entries[i];
+        if(entry->filename && entry->refCount == 0)
+        {
+            if(entry->isTable)
+            {
+                HEBitmapTable *bitmapTable = entry->asset;
+                bitmapTable->prv.isShared = 0;
+                HEBitmapTable_free(bitmapTable);
+            }
+            else
+            {
+                HEBitmap *bitmap = entry->asset;
+                bitmap->prv.isShared = 0;
+                HEBitmap_free(bitmap);
+            }
+            
+            size_t filename_size = strlen(entry->filename) + 1;
+            playdate->system->realloc(entry->filename, 0);
+            he_memory_free(HEMemoryMetadata, filename_size);
+            
+            // Slot i is checked again, it can hold a moved entry
+            he_cache_remove(i);
+            cache_count--;
+            purged_count++;
+            continue;
+        }
+        i++;
+    }
+    
+    if(purged_count == 0)
+    {
+        return;
+    }
+    
+    // Shrink, the table is still valid if it fails
+    unsigned int capacity = HE_CACHE_MIN_CAPACITY;
+    while(cache_count * 4 >= capacity * 3)
+    {
+        capacity *= 2;
+    }
+    if(capacity < cache_capacity)
+    {
+        he_cache_resize(capacity);
+    }
+}
+
+int he_cache_release(void *asset, uint32_t hash)
+{
+    if(!cache_entries)
+    {
+        return 0;
+    }
+    
+    // Same probe sequence as he_cache_find
+    unsigned int mask = cache_capacity - 1;
+    unsigned int i = hash & mask;
+    
+    while(cache_entries[i].filename)
+    {
+        _HECacheEntry *entry = &cache_entries[i];
+        if(entry->asset == asset)
+        {
+            if(entry->refCount > 0)
+            {
+                entry->refCount--;
+            }
+            return 1;
+        }
+        i = (i + 1) & mask;
+    }
+    return 0;
+}
+
+static void* he_cache_load(const char *filename, int isTable)
+{
+    uint32_t hash = he_cache_hash(filename, isTable);
+    
+    _HECacheEntry *entry = cache_entries ? he_cache_find(filename, hash, isTable) : NULL;
+    if(entry && entry->filename)
+    {
+        entry->refCount++;
+        return entry->asset;
+    }
+    
+    void *asset;
+    if(isTable)
+    {
+        HEBitmapTable *bitmapTable = has_extension(filename, ".hebt") ? HEBitmapTable_loadHEBT(filename) : HEBitmapTable_load(filename);
+        if(bitmapTable)
+        {
+            bitmapTable->prv.isShared = 1;
+            bitmapTable->prv.sharedHash = hash;
+        }
+        asset = bitmapTable;
+    }
+    else
+    {
+        HEBitmap *bitmap = has_extension(filename, ".heb") ? HEBitmap_loadHEB(filename) : HEBitmap_load(filename);
+        if(bitmap)
+        {
+            bitmap->prv.isShared = 1;
+            bitmap->prv.sharedHash = hash;
+        }
+        asset = bitmap;
+    }
+    
+    if(!asset)
+    {
+        return NULL;
+    }
+    
+    if((cache_count + 1) * 4 >= cache_capacity * 3)
+    {
+        // Keep the load factor under 3/4
+        if(!he_cache_resize(cache_capacity ? (cache_capacity * 2) : HE_CACHE_MIN_CAPACITY))
+        {
+            return asset;
+        }
+    }
+    
+    size_t filename_size = strlen(filename) + 1;
+    char *filename_copy = playdate->system->realloc(NULL, filename_size);
+    if(!filename_copy)
+    {
+        // Not shared, owned by the caller
+        playdate->system->logToConsole("HECache: cannot allocate entry for %s", filename);
+        return asset;
+    }
+    memcpy(filename_copy, filename, filename_size);
+    he_memory_alloc(HEMemoryMetadata, filename_size);
+    
+    entry = he_cache_find(filename, hash, isTable);
+    entry->filename = filename_copy;
+    entry->asset = asset;
+    entry->hash = hash;
+    entry->isTable = isTable;
+    entry->refCount = 1;
+    
+    cache_count++;
+    
+    return asset;
+}
+
+static _HECacheEntry* he_cache_find(const char *filename, uint32_t hash, int isTable)
+{
+    // Matching entry or the empty slot to insert into
+    unsigned int mask = cache_capacity - 1;
+    unsigned int i = hash & mask;
+    
+    while(cache_entries[i].filename)
+    {
+        _HECacheEntry *entry = &cache_entries[i];
+        if(entry->hash == hash && entry->isTable == isTable && strcmp(entry->filename, filename) == 0)
+        {
+            return entry;
+        }
+        i = (i + 1) & mask;
+    }
+    
+    return &cache_entries[i];
+}
+
+static void he_cache_remove(unsigned int index)
+{
+    // Linear probing without tombstones, later entries of the probe sequence are moved back
+    unsigned int mask = cache_capacity - 1;
+    unsigned int i = index;
+    unsigned int j = index;
+    
+    while(1)
+    {
+        j = (j + 1) & mask;
+        if(!cache_entries[j].filename)
+        {
+            break;
+        }
+        // Entries with their slot in (i, j] stay
+        unsigned int home = cache_entries[j].hash & mask;
+        if(((j - home) & mask) >= ((j - i) & mask))
+        {
+            cache_entries[i] = cache_entries[j];
+            i = j;
+        }
+    }
+    
+    cache_entries[i].filename = NULL;
+}
+
+static int he_cache_resize(unsigned int capacity)
+{
+    size_t entries_size = sizeof(_HECacheEntry) * capacity;
+    _HECacheEntry *entries = playdate->system->realloc(NULL, entries_size);
+    if(!entries)
+    {
+        playdate->system->logToConsole("HECache: cannot allocate %u entries", capacity);
+        return 0;
+    }
+    memset(entries, 0, entries_size);
+    he_memory_alloc(HEMemoryMetadata, entries_size);
+    
+    _HECacheEntry *old_entries = cache_entries;
+    unsigned int old_capacity = cache_capacity;
+    
+    cache_entries = entries;
+    cache_capacity = capacity;
+    
+    if(old_entries)
+    {
+        for(unsigned int i = 0; i < old_capacity; i++)
+        {
+            _HECacheEntry *entry = &old_entries[i];
+            if(entry->filename)
+            {
+                *he_cache_find(entry->filename, entry->hash, entry->isTable) = *entry;
+            }
+        }
+        
+        playdate->system->realloc(old_entries, 0);
+        he_memory_free(HEMemoryMetadata, sizeof(_HECacheEntry) * old_capacity);
+    }
+    
+    return 1;
+}
+
+static uint32_t he_cache_hash(const char *filename, int isTable)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for(const uint8_t *ptr = (const uint8_t*)filename; *ptr; ptr++)
+    {
+        hash = (hash ^ *ptr) * 16777619u;
+    }
+    return hash ^ (uint32_t)isTable;
+}
+
+static int has_extension(const char *filename, const char *extension)
+{
+    size_t len = strlen(filename);
+    size_t extension_len = strlen(extension);
+    return len >= extension_len && strcmp(filename + len - extension_len, extension) == 0;
+}
+
+void he_cache_init(PlaydateAPI *pd)
+{
+    playdate = pd;
+}
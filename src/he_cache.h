@@ -0,0 +1,28 @@
+//
+//  he_cache.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef he_cache_h
+#define he_cache_h
+
+#include "pd_api.h"
+#include "he_bitmap.h"
+
+typedef struct {
+    char *filename;
+    void *asset;
+    uint32_t hash;
+    int isTable;
+    unsigned int refCount;
+} _HECacheEntry;
+
+// Shared assets are loaded once per filename (heb/hebt or Playdate image), HEBitmap_free and HEBitmapTable_free release a reference
+HEBitmap* HEBitmap_loadShared(const char *filename);
+HEBitmapTable* HEBitmapTable_loadShared(const char *filename);
+// Frees shared assets without references
+void he_cache_purgeUnused(void);
+
+#endif /* he_cache_h */
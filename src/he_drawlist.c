@@ -0,0 +1,380 @@
+//
+//  he_drawlist.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <string.h>
+
+#include "he_api.h"
+#include "he_prv.h"
+
+static PlaydateAPI *playdate;
+
+static int HEDrawList_itemBounds(_HEDrawItem *item, HERect *bounds);
+static int HEDrawList_drawBands(HEDrawList *drawList, HEGraphicsContext *context);
+static void HEDrawList_cover(_HEDrawList *prv, HERect bounds, unsigned int owner);
+static int HEDrawList_drawItem(_HEDrawList *prv, _HEDrawItem *item, HERect bounds, unsigned int owner, HEGraphicsContext *context);
+static void HEDrawList_drawRect(_HEDrawItem *item, HERect bounds, int col1, int col2, int row1, int row2, HEGraphicsContext *context);
+
+HEDrawList* HEDrawList_new(void)
+{
+    HEDrawList *drawList = playdate->system->realloc(NULL, sizeof(HEDrawList));
+    if(!drawList)
+    {
+        playdate->system->logToConsole("HEDrawList: cannot allocate draw list");
+        return NULL;
+    }
+    
+    drawList->count = 0;
+    
+    _HEDrawList *prv = &drawList->prv;
+    
+    prv->items = NULL;
+    prv->capacity = 0;
+    prv->bandHeight = 0;
+    prv->binItems = NULL;
+    prv->binCapacity = 0;
+    
+    return drawList;
+}
+
+void HEDrawList_addBitmap(HEDrawList *drawList, HEBitmap *bitmap, int x, int y)
+{
+    HEDrawList_addBitmapInContext(drawList, bitmap, x, y, he_graphics_context);
+}
+
+void HEDrawList_addBitmapInContext(HEDrawList *drawList, HEBitmap *bitmap, int x, int y, HEGraphicsContext *context)
+{
+    _HEDrawList *prv = &drawList->prv;
+    
+    if(drawList->count >= prv->capacity)
+    {
+        unsigned int capacity = (prv->capacity > 0) ? (prv->capacity * 2) : 64;
+        _HEDrawItem *items = playdate->system->realloc(prv->items, sizeof(_HEDrawItem) * capacity);
+        if(!items)
+        {
+            playdate->system->logToConsole("HEDrawList: cannot allocate items");
+            return;
+        }
+        prv->items = items;
+        prv->capacity = capacity;
+    }
+    
+    prv->items[drawList->count++] = (_HEDrawItem){
+        .bitmap = bitmap,
+        .x = x,
+        .y = y,
+        .clipRect = context->clipRect
+    };
+}
+
+void HEDrawList_flush(HEDrawList *drawList)
+{
+    HEDrawList_flushInContext(drawList, he_graphics_context);
+}
+
+void HEDrawList_flushInContext(HEDrawList *drawList, HEGraphicsContext *target)
+{
+    _HEDrawList *prv = &drawList->prv;
+    
+    // Clip rects are set on a copy of the target
+    HEGraphicsContext context = *target;
+    
+    if(target->width > LCD_COLUMNS || target->height > LCD_ROWS)
+    {
+        // Tiles cover the display size only, draw in order
+        for(unsigned int i = 0; i < drawList->count; i++)
+        {
+            _HEDrawItem *item = &prv->items[i];
+            HERect clipRect = item->clipRect;
+            HEGraphicsContext_setClipRect(&context, clipRect.x, clipRect.y, clipRect.width, clipRect.height);
+            HEBitmap_drawInContext(item->bitmap, item->x, item->y, &context);
+        }
+        drawList->count = 0;
+        return;
+    }
+    
+    memset(prv->owners, 0, sizeof(prv->owners));
+    
+    // Tiles fully covered by an opaque draw
+    for(unsigned int i = 0; i < drawList->count; i++)
+    {
+        _HEDrawItem *item = &prv->items[i];
+        item->visible = HEDrawList_itemBounds(item, &item->bounds);
+        if(item->visible && !item->bitmap->prv.mask)
+        {
+            HEDrawList_cover(prv, item->bounds, i + 1);
+        }
+    }
+    
+    // Without bins the draws are not banded
+    if(prv->bandHeight == 0 || !HEDrawList_drawBands(drawList, &context))
+    {
+        for(unsigned int i = 0; i < drawList->count; i++)
+        {
+            _HEDrawItem *item = &prv->items[i];
+            if(item->visible && !HEDrawList_drawItem(prv, item, item->bounds, i + 1, &context))
+            {
+                HE_STATS_ADD(occludedDraws, 1);
+            }
+        }
+    }
+    
+    drawList->count = 0;
+}
+
+void HEDrawList_setBandHeight(HEDrawList *drawList, int rows)
+{
+    drawList->prv.bandHeight = he_max(0, he_min(rows, LCD_ROWS));
+}
+
+void HEDrawList_clear(HEDrawList *drawList)
+{
+    drawList->count = 0;
+}
+
+void HEDrawList_free(HEDrawList *drawList)
+{
+    _HEDrawList *prv = &drawList->prv;
+    
+    if(prv->items)
+    {
+        playdate->system->realloc(prv->items, 0);
+    }
+    
+    if(prv->binItems)
+    {
+        playdate->system->realloc(prv->binItems, 0);
+    }
+    
+    playdate->system->realloc(drawList, 0);
+}
+
+static int HEDrawList_itemBounds(_HEDrawItem *item, HERect *bounds)
+{
+    // Visible rect, same as the draw kernel
+    _HEBitmap *bitmap_prv = &item->bitmap->prv;
+    
+    int x = item->x + bitmap_prv->bx;
+    int y = item->y + bitmap_prv->by;
+    
+    HERect clipRect = item->clipRect;
+    
+    if(bitmap_prv->bw <= 0 || bitmap_prv->bh <= 0 || (x + bitmap_prv->bw) <= clipRect.x || x >= (clipRect.x + clipRect.width) || (y + bitmap_prv->bh) <= clipRect.y || y >= (clipRect.y + clipRect.height))
+    {
+        return 0;
+    }
+    
+    unsigned int x1, y1, x2, y2, offset_left, offset_top;
+    he_bitmap_clip_bounds(item->bitmap, x, y, &x1, &y1, &x2, &y2, &offset_left, &offset_top, clipRect);
+    
+    *bounds = he_rect_new(x1, y1, x2 - x1, y2 - y1);
+    
+    return 1;
+}
+
+static int HEDrawList_drawBands(HEDrawList *drawList, HEGraphicsContext *context)
+{
+    _HEDrawList *prv = &drawList->prv;
+    
+    int bandHeight = prv->bandHeight;
+    int bands = (LCD_ROWS + bandHeight - 1) / bandHeight;
+    
+    // Count draws per band, bins[band] is the start of the band
+    memset(prv->bins, 0, sizeof(unsigned int) * (bands + 1));
+    
+    for(unsigned int i = 0; i < drawList->count; i++)
+    {
+        _HEDrawItem *item = &prv->items[i];
+        if(item->visible)
+        {
+            int band1 = item->bounds.y / bandHeight;
+            int band2 = (item->bounds.y + item->bounds.height - 1) / bandHeight;
+            for(int band = band1; band <= band2; band++)
+            {
+                prv->bins[band + 1]++;
+            }
+        }
+    }
+    
+    for(int band = 0; band < bands; band++)
+    {
+        prv->bins[band + 1] += prv->bins[band];
+    }
+    
+    unsigned int binCount = prv->bins[bands];
+    if(binCount > prv->binCapacity)
+    {
+        unsigned int *binItems = playdate->system->realloc(prv->binItems, sizeof(unsigned int) * binCount);
+        if(!binItems)
+        {
+            playdate->system->logToConsole("HEDrawList: cannot allocate bins");
+            return 0;
+        }
+        prv->binItems = binItems;
+        prv->binCapacity = binCount;
+    }
+    
+    // Draws are added in order, each band keeps the submission order
+    unsigned int cursors[LCD_ROWS];
+    memcpy(cursors, prv->bins, sizeof(unsigned int) * bands);
+    
+    for(unsigned int i = 0; i < drawList->count; i++)
+    {
+        _HEDrawItem *item = &prv->items[i];
+        if(item->visible)
+        {
+            int band1 = item->bounds.y / bandHeight;
+            int band2 = (item->bounds.y + item->bounds.height - 1) / bandHeight;
+            for(int band = band1; band <= band2; band++)
+            {
+                prv->binItems[cursors[band]++] = i;
+            }
+        }
+    }
+    
+    for(int band = 0; band < bands; band++)
+    {
+        HERect bandRect = he_rect_new(0, band * bandHeight, LCD_COLUMNS, bandHeight);
+        
+        for(unsigned int j = prv->bins[band]; j < prv->bins[band + 1]; j++)
+        {
+            unsigned int i = prv->binItems[j];
+            _HEDrawItem *item = &prv->items[i];
+            if(HEDrawList_drawItem(prv, item, he_rect_intersection(bandRect, item->bounds), i + 1, context))
+            {
+                item->visible = 2;
+            }
+        }
+    }
+
+#if HE_STATS
+    for(unsigned int i = 0; i < drawList->count; i++)
+    {
+        if(prv->items[i].visible == 1)
+        {
+            HE_STATS_ADD(occludedDraws, 1);
+        }
+    }
+#endif
+    
+    return 1;
+}
+
+static void HEDrawList_cover(_HEDrawList *prv, HERect bounds, unsigned int owner)
+{
+    int x2 = bounds.x + bounds.width;
+    int y2 = bounds.y + bounds.height;
+    
+    // Tiles inside the bounds, the last column and row can be partial
+    int col1 = (bounds.x + HE_DRAWLIST_TILE_WIDTH - 1) / HE_DRAWLIST_TILE_WIDTH;
+    int col2 = (x2 >= LCD_COLUMNS) ? HE_DRAWLIST_COLUMNS : (x2 / HE_DRAWLIST_TILE_WIDTH);
+    int row1 = (bounds.y + HE_DRAWLIST_TILE_HEIGHT - 1) / HE_DRAWLIST_TILE_HEIGHT;
+    int row2 = (y2 >= LCD_ROWS) ? HE_DRAWLIST_ROWS : (y2 / HE_DRAWLIST_TILE_HEIGHT);
+    
+    for(int row = row1; row < row2; row++)
+    {
+        unsigned int *owners = prv->owners + row * HE_DRAWLIST_COLUMNS;
+        for(int col = col1; col < col2; col++)
+        {
+            owners[col] = owner;
+        }
+    }
+}
+
+static int HEDrawList_drawItem(_HEDrawList *prv, _HEDrawItem *item, HERect bounds, unsigned int owner, HEGraphicsContext *context)
+{
+    int col1 = bounds.x / HE_DRAWLIST_TILE_WIDTH;
+    int col2 = (bounds.x + bounds.width - 1) / HE_DRAWLIST_TILE_WIDTH;
+    int row1 = bounds.y / HE_DRAWLIST_TILE_HEIGHT;
+    int row2 = (bounds.y + bounds.height - 1) / HE_DRAWLIST_TILE_HEIGHT;
+    
+    // Consecutive rows with a single run of the same columns are drawn together
+    int pending_col1 = 0;
+    int pending_col2 = 0;
+    int pending_row1 = -1;
+    int visible = 0;
+    
+    for(int row = row1; row <= row2; row++)
+    {
+        unsigned int *owners = prv->owners + row * HE_DRAWLIST_COLUMNS;
+        
+        // Runs of visible tiles
+        int runs_col1[HE_DRAWLIST_COLUMNS];
+        int runs_col2[HE_DRAWLIST_COLUMNS];
+        int runs = 0;
+        
+        for(int col = col1; col <= col2; col++)
+        {
+            if(owners[col] > owner)
+            {
+                continue;
+            }
+            if(runs > 0 && runs_col2[runs - 1] == (col - 1))
+            {
+                runs_col2[runs - 1] = col;
+            }
+            else
+            {
+                runs_col1[runs] = col;
+                runs_col2[runs] = col;
+                runs++;
+            }
+        }
+        
+        if(runs > 0)
+        {
+            visible = 1;
+        }
+        
+        if(runs == 1 && pending_row1 >= 0 && runs_col1[0] == pending_col1 && runs_col2[0] == pending_col2)
+        {
+            continue;
+        }
+        
+        if(pending_row1 >= 0)
+        {
+            HEDrawList_drawRect(item, bounds, pending_col1, pending_col2, pending_row1, row - 1, context);
+            pending_row1 = -1;
+        }
+        
+        if(runs == 1)
+        {
+            pending_col1 = runs_col1[0];
+            pending_col2 = runs_col2[0];
+            pending_row1 = row;
+        }
+        else
+        {
+            for(int i = 0; i < runs; i++)
+            {
+                HEDrawList_drawRect(item, bounds, runs_col1[i], runs_col2[i], row, row, context);
+            }
+        }
+    }
+    
+    if(pending_row1 >= 0)
+    {
+        HEDrawList_drawRect(item, bounds, pending_col1, pending_col2, pending_row1, row2, context);
+    }
+    
+    return visible;
+}
+
+static void HEDrawList_drawRect(_HEDrawItem *item, HERect bounds, int col1, int col2, int row1, int row2, HEGraphicsContext *context)
+{
+    int x1 = he_max(col1 * HE_DRAWLIST_TILE_WIDTH, bounds.x);
+    int x2 = he_min((col2 + 1) * HE_DRAWLIST_TILE_WIDTH, bounds.x + bounds.width);
+    int y1 = he_max(row1 * HE_DRAWLIST_TILE_HEIGHT, bounds.y);
+    int y2 = he_min((row2 + 1) * HE_DRAWLIST_TILE_HEIGHT, bounds.y + bounds.height);
+    
+    HEGraphicsContext_setClipRect(context, x1, y1, x2 - x1, y2 - y1);
+    HEBitmap_drawInContext(item->bitmap, item->x, item->y, context);
+}
+
+void he_drawlist_init(PlaydateAPI *pd)
+{
+    playdate = pd;
+}
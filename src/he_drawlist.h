@@ -0,0 +1,61 @@
+//
+//  he_drawlist.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef he_drawlist_h
+#define he_drawlist_h
+
+#include "pd_api.h"
+#include "he_foundation.h"
+#include "he_bitmap.h"
+
+// Coverage tiles are one word wide
+#define HE_DRAWLIST_TILE_WIDTH 32
+#define HE_DRAWLIST_COLUMNS ((LCD_COLUMNS + HE_DRAWLIST_TILE_WIDTH - 1) / HE_DRAWLIST_TILE_WIDTH)
+#define HE_DRAWLIST_ROWS ((LCD_ROWS + HE_DRAWLIST_TILE_HEIGHT - 1) / HE_DRAWLIST_TILE_HEIGHT)
+
+typedef struct {
+    HEBitmap *bitmap;
+    int x;
+    int y;
+    HERect clipRect;
+    HERect bounds;
+    // 1 if visible, 2 once drawn in a band
+    int visible;
+} _HEDrawItem;
+
+typedef struct {
+    _HEDrawItem *items;
+    unsigned int capacity;
+    int bandHeight;
+    // Draw indexes sorted by band
+    unsigned int *binItems;
+    unsigned int binCapacity;
+    unsigned int bins[LCD_ROWS + 1];
+    // Last opaque draw (index + 1) covering each tile
+    unsigned int owners[HE_DRAWLIST_COLUMNS * HE_DRAWLIST_ROWS];
+} _HEDrawList;
+
+typedef struct HEDrawList {
+    _HEDrawList prv;
+    unsigned int count;
+} HEDrawList;
+
+HEDrawList* HEDrawList_new(void);
+// Records a draw with the current clip rect, the bitmap must be valid until flush
+// Delta frames of a table share the playback buffer, add one per table
+void HEDrawList_addBitmap(HEDrawList *drawList, HEBitmap *bitmap, int x, int y);
+void HEDrawList_addBitmapInContext(HEDrawList *drawList, HEBitmap *bitmap, int x, int y, HEGraphicsContext *context);
+// Draws in order, skipping tiles covered by later opaque draws
+void HEDrawList_flush(HEDrawList *drawList);
+// Draws in the frame of context, clip rects are the ones recorded by add
+void HEDrawList_flushInContext(HEDrawList *drawList, HEGraphicsContext *context);
+// Renders band by band (0 to disable), draws keep their order within a band
+void HEDrawList_setBandHeight(HEDrawList *drawList, int rows);
+void HEDrawList_clear(HEDrawList *drawList);
+void HEDrawList_free(HEDrawList *drawList);
+
+#endif /* he_drawlist_h */
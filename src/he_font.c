@@ -0,0 +1,517 @@
+//
+//  he_font.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "he_api.h"
+#include "he_prv.h"
+
+static PlaydateAPI *playdate;
+
+static char* HEFont_readFile(const char *filename);
+static int HEFont_parseMetrics(HEFont *font, char *metrics);
+static _HEGlyph* HEFont_glyph(HEFont *font, uint32_t codepoint);
+static void HEFont_drawGlyph(uint8_t *frame, int rowbytes, HEBitmap *bitmap, int x, int y, HERect clipRect, int *rows_y1, int *rows_y2);
+static int HEFont_linesCount(const char *text);
+static uint32_t utf8_next(const char **text);
+static int compare_glyph(const void *a, const void *b);
+
+HEFont* HEFont_load(const char *tableFilename, const char *metricsFilename)
+{
+    HEBitmapTable *bitmapTable = HEBitmapTable_loadHEBT(tableFilename);
+    if(!bitmapTable)
+    {
+        return NULL;
+    }
+    
+    if(bitmapTable->prv.deltas || bitmapTable->length == 0)
+    {
+        // Glyphs are drawn in any order
+        playdate->system->logToConsole("HEFont: invalid glyph table %s", tableFilename);
+        HEBitmapTable_free(bitmapTable);
+        return NULL;
+    }
+    
+    char *metrics = HEFont_readFile(metricsFilename);
+    if(!metrics)
+    {
+        HEBitmapTable_free(bitmapTable);
+        return NULL;
+    }
+    
+    HEFont *font = playdate->system->realloc(NULL, sizeof(HEFont));
+    if(!font)
+    {
+        playdate->system->logToConsole("HEFont: cannot allocate font for %s", tableFilename);
+        playdate->system->realloc(metrics, 0);
+        HEBitmapTable_free(bitmapTable);
+        return NULL;
+    }
+    
+    _HEFont *prv = &font->prv;
+    
+    prv->bitmapTable = bitmapTable;
+    prv->glyphs = NULL;
+    prv->glyphsCount = 0;
+    prv->tracking = 0;
+    
+    font->height = HEBitmap_atIndex(bitmapTable, 0)->height;
+    
+    int success = HEFont_parseMetrics(font, metrics);
+    playdate->system->realloc(metrics, 0);
+    
+    if(!success)
+    {
+        HEFont_free(font);
+        return NULL;
+    }
+    
+    return font;
+}
+
+void HEFont_drawText(HEFont *font, const char *text, int x, int y)
+{
+    HEFont_drawTextInContext(font, text, x, y, he_graphics_context);
+}
+
+void HEFont_drawTextInContext(HEFont *font, const char *text, int x, int y, HEGraphicsContext *context)
+{
+    _HEFont *prv = &font->prv;
+    
+    // Glyphs share the clip rect and frame
+    HERect clipRect = context->clipRect;
+    uint8_t *frame = he_graphics_frame(context);
+    
+    int rows_y1 = context->height;
+    int rows_y2 = 0;
+    
+    int line_x = x;
+    
+    while(*text)
+    {
+        uint32_t codepoint = utf8_next(&text);
+        if(codepoint == '\n')
+        {
+            x = line_x;
+            y += font->height;
+            continue;
+        }
+        
+        _HEGlyph *glyph = HEFont_glyph(font, codepoint);
+        if(!glyph)
+        {
+            continue;
+        }
+        
+        HEBitmap *bitmap = glyph->bitmap;
+        if(bitmap->prv.rowbytes == 4)
+        {
+            HEFont_drawGlyph(frame, context->rowbytes, bitmap, x, y, clipRect, &rows_y1, &rows_y2);
+        }
+        else
+        {
+            HEBitmap_drawInContext(bitmap, x, y, context);
+        }
+        
+        x += glyph->advance + prv->tracking;
+    }
+    
+    if(rows_y1 < rows_y2)
+    {
+        he_graphics_markUpdatedRows(context, rows_y1, rows_y2 - 1);
+    }
+}
+
+int HEFont_getTextWidth(HEFont *font, const char *text)
+{
+    _HEFont *prv = &font->prv;
+    
+    int width = 0;
+    int line_width = 0;
+    int line_glyphs = 0;
+    
+    while(1)
+    {
+        uint32_t codepoint = *text ? utf8_next(&text) : '\0';
+        if(codepoint == '\n' || codepoint == '\0')
+        {
+            if(line_glyphs > 0)
+            {
+                // No tracking after the last glyph
+                width = he_max(width, line_width - prv->tracking);
+            }
+            if(codepoint == '\0')
+            {
+                break;
+            }
+            line_width = 0;
+            line_glyphs = 0;
+            continue;
+        }
+        
+        _HEGlyph *glyph = HEFont_glyph(font, codepoint);
+        if(glyph)
+        {
+            line_width += glyph->advance + prv->tracking;
+            line_glyphs++;
+        }
+    }
+    
+    return width;
+}
+
+HEBitmap* HEFont_renderText(HEFont *font, const char *text)
+{
+    _HEFont *prv = &font->prv;
+    
+    int width = HEFont_getTextWidth(font, text);
+    int height = HEFont_linesCount(text) * font->height;
+    
+    // Glyphs can be wider than their advance
+    int x = 0;
+    
+    for(const char *ptr = text; *ptr;)
+    {
+        uint32_t codepoint = utf8_next(&ptr);
+        if(codepoint == '\n')
+        {
+            x = 0;
+            continue;
+        }
+        
+        _HEGlyph *glyph = HEFont_glyph(font, codepoint);
+        if(glyph)
+        {
+            width = he_max(width, x + glyph->bitmap->prv.bx + glyph->bitmap->prv.bw);
+            x += glyph->advance + prv->tracking;
+        }
+    }
+    
+    int rowbytes = ((width + 31) / 32) * 4;
+    size_t data_size = he_max(rowbytes * height, 1);
+    
+    uint8_t *data = playdate->system->realloc(NULL, data_size);
+    uint8_t *mask = playdate->system->realloc(NULL, data_size);
+    if(!data || !mask)
+    {
+        playdate->system->logToConsole("HEFont: cannot allocate text");
+        playdate->system->realloc(data, 0);
+        playdate->system->realloc(mask, 0);
+        return NULL;
+    }
+    memset(data, 0x00, data_size);
+    memset(mask, 0x00, data_size);
+    
+    x = 0;
+    int y = 0;
+    
+    while(*text)
+    {
+        uint32_t codepoint = utf8_next(&text);
+        if(codepoint == '\n')
+        {
+            x = 0;
+            y += font->height;
+            continue;
+        }
+        
+        _HEGlyph *glyph = HEFont_glyph(font, codepoint);
+        if(!glyph)
+        {
+            continue;
+        }
+        
+        _HEBitmap *glyph_prv = &glyph->bitmap->prv;
+        
+        for(int row = 0; row < glyph_prv->bh; row++)
+        {
+            int dst_y = y + glyph_prv->by + row;
+            
+            for(int col = 0; col < glyph_prv->bw; col++)
+            {
+                int dst_x = x + glyph_prv->bx + col;
+                if(dst_x < 0 || dst_x >= width || dst_y < 0 || dst_y >= height)
+                {
+                    continue;
+                }
+                
+                int src_i = row * glyph_prv->rowbytes + col / 8;
+                uint8_t src_bit = 1 << (7 - col % 8);
+                
+                if(glyph_prv->mask && !(glyph_prv->mask[src_i] & src_bit))
+                {
+                    continue;
+                }
+                
+                int white = glyph_prv->hasFill ? (glyph_prv->fill != 0) : (glyph_prv->data[src_i] & src_bit) != 0;
+                
+                int dst_i = dst_y * rowbytes + dst_x / 8;
+                uint8_t dst_bit = 1 << (7 - dst_x % 8);
+                
+                mask[dst_i] |= dst_bit;
+                if(white)
+                {
+                    data[dst_i] |= dst_bit;
+                }
+                else
+                {
+                    data[dst_i] &= ~dst_bit;
+                }
+            }
+        }
+        
+        x += glyph->advance + prv->tracking;
+    }
+    
+    return _HEBitmap_fromPlanes(width, height, data, mask, rowbytes);
+}
+
+void HEFont_free(HEFont *font)
+{
+    _HEFont *prv = &font->prv;
+    
+    if(prv->glyphs)
+    {
+        playdate->system->realloc(prv->glyphs, 0);
+    }
+    
+    HEBitmapTable_free(prv->bitmapTable);
+    
+    playdate->system->realloc(font, 0);
+}
+
+static void HEFont_drawGlyph(uint8_t *frame, int rowbytes, HEBitmap *bitmap, int x, int y, HERect clipRect, int *rows_y1, int *rows_y2)
+{
+    // Narrow glyph (one word per row), each row is written to two frame words at most
+    _HEBitmap *prv = &bitmap->prv;
+    
+    x += prv->bx;
+    y += prv->by;
+    
+    int x1 = he_max(x, clipRect.x);
+    int x2 = he_min(x + prv->bw, clipRect.x + clipRect.width);
+    int y1 = he_max(y, clipRect.y);
+    int y2 = he_min(y + prv->bh, clipRect.y + clipRect.height);
+    
+    if(x1 >= x2 || y1 >= y2)
+    {
+        return;
+    }
+    
+    // Columns relative to the first frame word
+    int base = x1 / 32 * 32;
+    int offset = x - base;
+    uint64_t clip_mask = he_narrow_clip_mask(base, x1, x2);
+    
+    uint8_t *data_start = prv->data ? (prv->data + (y1 - y) * 4) : NULL;
+    uint8_t *mask_start = prv->mask ? (prv->mask + (y1 - y) * 4) : NULL;
+    uint32_t *frame_ptr = (uint32_t*)(frame + y1 * rowbytes + base / 8);
+    
+    for(int row = y1; row < y2; row++)
+    {
+        uint32_t data = data_start ? bswap32(*(uint32_t*)data_start) : prv->fill;
+        uint32_t mask = mask_start ? bswap32(*(uint32_t*)mask_start) : 0xFFFFFFFF;
+        
+        he_narrow_row(frame_ptr, data, mask, offset, clip_mask);
+        
+        if(data_start)
+        {
+            data_start += 4;
+        }
+        if(mask_start)
+        {
+            mask_start += 4;
+        }
+        frame_ptr += rowbytes / 4;
+    }
+    
+    *rows_y1 = he_min(*rows_y1, y1);
+    *rows_y2 = he_max(*rows_y2, y2);
+}
+
+static int HEFont_parseMetrics(HEFont *font, char *metrics)
+{
+    _HEFont *prv = &font->prv;
+    
+    unsigned int length = prv->bitmapTable->length;
+    
+    prv->glyphs = playdate->system->realloc(NULL, sizeof(_HEGlyph) * length);
+    if(!prv->glyphs)
+    {
+        playdate->system->logToConsole("HEFont: cannot allocate glyphs");
+        return 0;
+    }
+    
+    unsigned int glyph_index = 0;
+    char *line = metrics;
+    
+    while(line && *line)
+    {
+        char *next_line = strchr(line, '\n');
+        if(next_line)
+        {
+            *next_line++ = '\0';
+        }
+        
+        char *line_end = line + strlen(line);
+        if(line_end > line && line_end[-1] == '\r')
+        {
+            line_end[-1] = '\0';
+        }
+        
+        if(strncmp(line, "tracking=", 9) == 0)
+        {
+            prv->tracking = atoi(line + 9);
+        }
+        else if(*line != '\0' && strncmp(line, "--", 2) != 0)
+        {
+            // Glyph: character (or "space") and advance, kerning pairs and other key=value lines are ignored
+            char *token_end = line;
+            while(*token_end != '\0' && *token_end != ' ' && *token_end != '\t')
+            {
+                token_end++;
+            }
+            
+            const char *token = line;
+            uint32_t codepoint = ' ';
+            int is_glyph = 1;
+            
+            if((token_end - line) != 5 || strncmp(line, "space", 5) != 0)
+            {
+                // The '=' glyph is a single character token
+                codepoint = utf8_next(&token);
+                is_glyph = (token == token_end);
+            }
+            
+            if(is_glyph)
+            {
+                if(glyph_index < length)
+                {
+                    _HEGlyph *glyph = &prv->glyphs[prv->glyphsCount++];
+                    glyph->codepoint = codepoint;
+                    glyph->advance = atoi(token_end);
+                    glyph->bitmap = HEBitmap_atIndex(prv->bitmapTable, glyph_index);
+                }
+                glyph_index++;
+            }
+        }
+        
+        line = next_line;
+    }
+    
+    qsort(prv->glyphs, prv->glyphsCount, sizeof(_HEGlyph), compare_glyph);
+    
+    for(int i = 0; i < 128; i++)
+    {
+        prv->ascii[i] = -1;
+    }
+    for(unsigned int i = 0; i < prv->glyphsCount; i++)
+    {
+        if(prv->glyphs[i].codepoint < 128)
+        {
+            prv->ascii[prv->glyphs[i].codepoint] = i;
+        }
+    }
+    
+    return 1;
+}
+
+static _HEGlyph* HEFont_glyph(HEFont *font, uint32_t codepoint)
+{
+    _HEFont *prv = &font->prv;
+    
+    if(codepoint < 128)
+    {
+        int index = prv->ascii[codepoint];
+        return (index >= 0) ? &prv->glyphs[index] : NULL;
+    }
+    
+    _HEGlyph key = { .codepoint = codepoint };
+    return bsearch(&key, prv->glyphs, prv->glyphsCount, sizeof(_HEGlyph), compare_glyph);
+}
+
+static int HEFont_linesCount(const char *text)
+{
+    int count = 1;
+    for(; *text; text++)
+    {
+        if(*text == '\n')
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+static char* HEFont_readFile(const char *filename)
+{
+    SDFile *file = playdate->file->open(filename, kFileRead);
+    if(!file)
+    {
+        playdate->system->logToConsole("HEFont: cannot open %s", filename);
+        return NULL;
+    }
+    
+    playdate->file->seek(file, 0, SEEK_END);
+    int file_size = playdate->file->tell(file);
+    playdate->file->seek(file, 0, SEEK_SET);
+    
+    char *buffer = playdate->system->realloc(NULL, he_max(file_size, 0) + 1);
+    if(buffer)
+    {
+        int len = playdate->file->read(file, buffer, he_max(file_size, 0));
+        buffer[he_max(len, 0)] = '\0';
+    }
+    
+    playdate->file->close(file);
+    
+    return buffer;
+}
+
+static uint32_t utf8_next(const char **text)
+{
+    const uint8_t *ptr = (const uint8_t*)*text;
+    uint32_t codepoint = *ptr++;
+    
+    int extra = 0;
+    if(codepoint >= 0xF0)
+    {
+        codepoint &= 0x07;
+        extra = 3;
+    }
+    else if(codepoint >= 0xE0)
+    {
+        codepoint &= 0x0F;
+        extra = 2;
+    }
+    else if(codepoint >= 0xC0)
+    {
+        codepoint &= 0x1F;
+        extra = 1;
+    }
+    
+    for(int i = 0; i < extra && (*ptr & 0xC0) == 0x80; i++)
+    {
+        codepoint = (codepoint << 6) | (*ptr++ & 0x3F);
+    }
+    
+    *text = (const char*)ptr;
+    return codepoint;
+}
+
+static int compare_glyph(const void *a, const void *b)
+{
+    uint32_t ca = ((const _HEGlyph*)a)->codepoint;
+    uint32_t cb = ((const _HEGlyph*)b)->codepoint;
+    return (ca > cb) - (ca < cb);
+}
+
+void he_font_init(PlaydateAPI *pd)
+{
+    playdate = pd;
+}
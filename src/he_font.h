@@ -0,0 +1,43 @@
+//
+//  he_font.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef he_font_h
+#define he_font_h
+
+#include "pd_api.h"
+#include "he_bitmap.h"
+
+typedef struct {
+    uint32_t codepoint;
+    int advance;
+    HEBitmap *bitmap;
+} _HEGlyph;
+
+typedef struct {
+    HEBitmapTable *bitmapTable;
+    // Sorted by codepoint
+    _HEGlyph *glyphs;
+    unsigned int glyphsCount;
+    int16_t ascii[128];
+    int tracking;
+} _HEFont;
+
+typedef struct HEFont {
+    _HEFont prv;
+    int height;
+} HEFont;
+
+// Glyph table (hebt) and Playdate font metrics (fnt), glyphs are in the same order as the metrics
+HEFont* HEFont_load(const char *tableFilename, const char *metricsFilename);
+void HEFont_drawText(HEFont *font, const char *text, int x, int y);
+void HEFont_drawTextInContext(HEFont *font, const char *text, int x, int y, HEGraphicsContext *context);
+int HEFont_getTextWidth(HEFont *font, const char *text);
+// Renders the text once for static labels, free with HEBitmap_free
+HEBitmap* HEFont_renderText(HEFont *font, const char *text);
+void HEFont_free(HEFont *font);
+
+#endif /* he_font_h */
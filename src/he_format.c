@@ -0,0 +1,381 @@
+//
+//  he_format.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <string.h>
+
+#include "he_format.h"
+
+size_t he_format_padding(size_t len)
+{
+    // Padding length (uint32) is included
+    size_t padding = (len + 4) % HE_FORMAT_ALIGNMENT;
+    if(padding > 0)
+    {
+        padding = HE_FORMAT_ALIGNMENT - padding;
+    }
+    return padding;
+}
+
+size_t he_format_bitmap_header_size(uint32_t version)
+{
+    size_t len = 8 * 4 + 1;
+    if(version >= 3)
+    {
+        // Version 3 supports compression
+        len += 1;
+    }
+    if(version >= 7)
+    {
+        // Version 7 supports fill
+        len += 1;
+    }
+    if(version >= 2)
+    {
+        // Version 2 supports padding
+        len += 4 + he_format_padding(len);
+    }
+    return len;
+}
+
+size_t he_format_write_bitmap_header(uint8_t *dst, const HEFormatBitmapHeader *header)
+{
+    uint8_t *dst_ptr = dst;
+    
+    he_format_write_uint32(dst_ptr, header->version); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->width); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->height); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->bx); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->by); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->bw); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->bh); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->rowbytes); dst_ptr += 4;
+    *dst_ptr++ = header->hasMask;
+    
+    if(header->version >= 3)
+    {
+        *dst_ptr++ = header->compressed;
+    }
+    
+    if(header->version >= 7)
+    {
+        *dst_ptr++ = header->fill;
+    }
+    
+    if(header->version >= 2)
+    {
+        size_t padding = he_format_padding(dst_ptr - dst);
+        he_format_write_uint32(dst_ptr, (uint32_t)padding); dst_ptr += 4;
+        memset(dst_ptr, 0, padding);
+        dst_ptr += padding;
+    }
+    
+    return dst_ptr - dst;
+}
+
+size_t he_format_table_header_size(uint32_t version, int compressed)
+{
+    size_t len = 2 * 4;
+    if(version >= 3)
+    {
+        // Version 3 supports compression
+        len += 1;
+        if(version >= 4 && compressed)
+        {
+            // Version 4 supports allocator
+            len += 4;
+        }
+        if(version >= 9 && compressed == HE_FORMAT_COMPRESSION_LZ)
+        {
+            // Version 9 supports dictionary
+            len += 2 * 4;
+        }
+    }
+    if(version >= 2)
+    {
+        // Version 2 supports padding
+        len += 4 + he_format_padding(len);
+    }
+    return len;
+}
+
+size_t he_format_write_table_header(uint8_t *dst, const HEFormatTableHeader *header)
+{
+    uint8_t *dst_ptr = dst;
+    
+    he_format_write_uint32(dst_ptr, header->version); dst_ptr += 4;
+    he_format_write_uint32(dst_ptr, header->length); dst_ptr += 4;
+    
+    if(header->version >= 3)
+    {
+        *dst_ptr++ = header->compressed;
+        
+        if(header->version >= 4 && header->compressed)
+        {
+            he_format_write_uint32(dst_ptr, header->allocatorSize); dst_ptr += 4;
+        }
+        
+        if(header->version >= 9 && header->compressed == HE_FORMAT_COMPRESSION_LZ)
+        {
+            he_format_write_uint32(dst_ptr, header->dictionarySize); dst_ptr += 4;
+            he_format_write_uint32(dst_ptr, header->dictionaryLength); dst_ptr += 4;
+        }
+    }
+    
+    if(header->version >= 2)
+    {
+        size_t padding = he_format_padding(dst_ptr - dst);
+        he_format_write_uint32(dst_ptr, (uint32_t)padding); dst_ptr += 4;
+        memset(dst_ptr, 0, padding);
+        dst_ptr += padding;
+    }
+    
+    return dst_ptr - dst;
+}
+
+size_t he_format_table_index_size(uint32_t version, uint32_t length)
+{
+    if(version >= 8)
+    {
+        // Version 8 supports frame index
+        return (size_t)length * HE_FORMAT_FRAME_INDEX_SIZE;
+    }
+    return 0;
+}
+
+int he_format_mask_is_opaque(const uint8_t *mask, uint32_t rowbytes, uint32_t bw, uint32_t bh)
+{
+    uint32_t full_bytes = bw / 8;
+    uint8_t last_bits = (uint8_t)(0xFF << (8 - bw % 8));
+    
+    for(uint32_t row = 0; row < bh; row++)
+    {
+        const uint8_t *mask_row = mask + row * rowbytes;
+        for(uint32_t i = 0; i < full_bytes; i++)
+        {
+            if(mask_row[i] != 0xFF)
+            {
+                return 0;
+            }
+        }
+        if((bw % 8) > 0 && (mask_row[full_bytes] & last_bits) != last_bits)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+uint8_t he_format_fill(const uint8_t *data, const uint8_t *mask, uint32_t rowbytes, uint32_t bw, uint32_t bh)
+{
+    uint32_t bytes = (bw + 7) / 8;
+    uint8_t last_bits = (bw % 8) > 0 ? (uint8_t)(0xFF << (8 - bw % 8)) : 0xFF;
+    
+    int black = 0;
+    int white = 0;
+    
+    for(uint32_t row = 0; row < bh; row++)
+    {
+        for(uint32_t i = 0; i < bytes; i++)
+        {
+            size_t offset = row * rowbytes + i;
+            uint8_t visible = mask[offset];
+            if((i + 1) == bytes)
+            {
+                visible &= last_bits;
+            }
+            white |= (data[offset] & visible) != 0;
+            black |= (~data[offset] & visible) != 0;
+        }
+        if(white && black)
+        {
+            return HE_FORMAT_FILL_NONE;
+        }
+    }
+    
+    return white ? HE_FORMAT_FILL_WHITE : HE_FORMAT_FILL_BLACK;
+}
+
+size_t he_format_compress_bound(size_t len)
+{
+    // Worst case: one (count, value) pair for each byte
+    return len * 2;
+}
+
+size_t he_format_compress(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t dst_len = 0;
+    size_t i = 0;
+    
+    while(i < len)
+    {
+        uint8_t value = src[i];
+        size_t count = 1;
+        while((i + count) < len && src[i + count] == value && count < 255)
+        {
+            count++;
+        }
+        
+        dst[dst_len++] = (uint8_t)count;
+        dst[dst_len++] = value;
+        i += count;
+    }
+    
+    return dst_len;
+}
+
+size_t he_format_decompress(uint8_t *dst, size_t len, const uint8_t *src, size_t src_len)
+{
+    const uint8_t *src_ptr = src;
+    const uint8_t *src_end = src + src_len;
+    size_t i = 0;
+    
+    while(i < len)
+    {
+        if((src_end - src_ptr) < 2)
+        {
+            // Truncated source
+            memset(dst + i, 0, len - i);
+            return src_len + 1;
+        }
+        
+        uint8_t count = *src_ptr++;
+        uint8_t value = *src_ptr++;
+        size_t end = i + count;
+        if(end > len)
+        {
+            end = len;
+        }
+        memset(dst + i, value, end - i);
+        i = end;
+    }
+    
+    return src_ptr - src;
+}
+
+static int he_format_lz_length(const uint8_t **src_ptr, const uint8_t *src_end, size_t *len)
+{
+    if(*len == 15)
+    {
+        // Extended length
+        uint8_t value;
+        do
+        {
+            if(*src_ptr >= src_end)
+            {
+                return 0;
+            }
+            value = *(*src_ptr)++;
+            *len += value;
+        } while(value == 255);
+    }
+    return 1;
+}
+
+size_t he_format_lz_decompress(uint8_t *dst, size_t len, const uint8_t *src, size_t src_len, const uint8_t *dictionary, size_t dictionarySize)
+{
+    const uint8_t *src_ptr = src;
+    const uint8_t *src_end = src + src_len;
+    size_t i = 0;
+    
+    while(i < len)
+    {
+        if(src_ptr >= src_end)
+        {
+            break;
+        }
+        
+        // Token: literals count (high nibble), match length - 4 (low nibble), 15 is extended
+        uint8_t token = *src_ptr++;
+        
+        size_t literals = token >> 4;
+        if(!he_format_lz_length(&src_ptr, src_end, &literals))
+        {
+            break;
+        }
+        if(literals > (len - i))
+        {
+            literals = len - i;
+        }
+        if(literals > (size_t)(src_end - src_ptr))
+        {
+            break;
+        }
+        memcpy(dst + i, src_ptr, literals);
+        src_ptr += literals;
+        i += literals;
+        
+        if(i >= len)
+        {
+            // The last sequence has no match
+            break;
+        }
+        
+        if((src_end - src_ptr) < 2)
+        {
+            break;
+        }
+        size_t offset = (size_t)src_ptr[0] << 8 | src_ptr[1];
+        src_ptr += 2;
+        
+        size_t match_len = token & 0x0F;
+        if(!he_format_lz_length(&src_ptr, src_end, &match_len))
+        {
+            break;
+        }
+        match_len += HE_FORMAT_LZ_MIN_MATCH;
+        if(match_len > (len - i))
+        {
+            match_len = len - i;
+        }
+        
+        he_format_lz_copy(dst, i, match_len, offset, dictionary, dictionarySize);
+        i += match_len;
+    }
+    
+    if(i < len)
+    {
+        // Truncated source
+        memset(dst + i, 0, len - i);
+        return src_len + 1;
+    }
+    
+    return src_ptr - src;
+}
+
+void he_format_lz_copy(uint8_t *dst, size_t pos, size_t len, size_t offset, const uint8_t *dictionary, size_t dictionarySize)
+{
+    if(offset == 0 || offset > (pos + dictionarySize))
+    {
+        // Invalid offset
+        memset(dst + pos, 0, len);
+        return;
+    }
+    
+    size_t i = 0;
+    
+    if(offset > pos)
+    {
+        // Match starts in the dictionary
+        size_t back = offset - pos;
+        i = (back < len) ? back : len;
+        memcpy(dst + pos, dictionary + dictionarySize - back, i);
+    }
+    
+    if((len - i) <= offset)
+    {
+        memcpy(dst + pos + i, dst + pos + i - offset, len - i);
+    }
+    else
+    {
+        // Overlapping match, repeats the last offset bytes
+        for(; i < len; i++)
+        {
+            dst[pos + i] = dst[pos + i - offset];
+        }
+    }
+}
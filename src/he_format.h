@@ -0,0 +1,109 @@
+//
+//  he_format.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef he_format_h
+#define he_format_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+//
+// HEB/HEBT file format shared by the library and hebtool
+// No Playdate SDK dependency
+//
+#define HE_FORMAT_VERSION 9
+
+// Version 5: a table entry with this bit set in its size is a reference to a previous frame index
+#define HE_FORMAT_FRAME_REFERENCE 0x80000000
+// Version 6: a table entry with this bit set contains the changed word runs from the previous frame
+#define HE_FORMAT_FRAME_DELTA 0x40000000
+#define HE_FORMAT_FRAME_SIZE_MASK 0x3FFFFFFF
+
+// Version 7: a masked bitmap with visible pixels of a single color has no data plane
+#define HE_FORMAT_FILL_NONE 0
+#define HE_FORMAT_FILL_BLACK 1
+#define HE_FORMAT_FILL_WHITE 2
+
+// Version 8: the table header is followed by an index with the offset (0 for references) and size entry of each frame
+#define HE_FORMAT_FRAME_INDEX_SIZE 8
+
+// Compression of the planes (compressed byte)
+#define HE_FORMAT_COMPRESSION_NONE 0
+#define HE_FORMAT_COMPRESSION_RLE 1
+// Version 9: LZ sequences, table frames can match a dictionary saved after the frame index
+#define HE_FORMAT_COMPRESSION_LZ 2
+
+#define HE_FORMAT_LZ_MIN_MATCH 4
+#define HE_FORMAT_LZ_WINDOW 65535
+#define HE_FORMAT_LZ_DICTIONARY_MAX 32768
+
+// Header fields are aligned to 32 bytes
+#define HE_FORMAT_ALIGNMENT 32
+
+typedef struct {
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bx;
+    uint32_t by;
+    uint32_t bw;
+    uint32_t bh;
+    uint32_t rowbytes;
+    uint8_t hasMask;
+    uint8_t compressed;
+    uint8_t fill;
+} HEFormatBitmapHeader;
+
+typedef struct {
+    uint32_t version;
+    uint32_t length;
+    uint8_t compressed;
+    uint32_t allocatorSize;
+    uint32_t dictionarySize;
+    uint32_t dictionaryLength;
+} HEFormatTableHeader;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} HEFormatFrameIndex;
+
+static inline uint32_t he_format_read_uint32(const uint8_t *buffer)
+{
+    return (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 | (uint32_t)buffer[2] << 8 | (uint32_t)buffer[3];
+}
+
+static inline void he_format_write_uint32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (value >> 24) & 0xFF;
+    buffer[1] = (value >> 16) & 0xFF;
+    buffer[2] = (value >> 8) & 0xFF;
+    buffer[3] = value & 0xFF;
+}
+
+size_t he_format_padding(size_t len);
+
+size_t he_format_bitmap_header_size(uint32_t version);
+size_t he_format_write_bitmap_header(uint8_t *dst, const HEFormatBitmapHeader *header);
+size_t he_format_table_header_size(uint32_t version, int compressed);
+size_t he_format_write_table_header(uint8_t *dst, const HEFormatTableHeader *header);
+size_t he_format_table_index_size(uint32_t version, uint32_t length);
+
+// Plane elimination, only the first bw columns of each row are checked
+int he_format_mask_is_opaque(const uint8_t *mask, uint32_t rowbytes, uint32_t bw, uint32_t bh);
+uint8_t he_format_fill(const uint8_t *data, const uint8_t *mask, uint32_t rowbytes, uint32_t bw, uint32_t bh);
+
+size_t he_format_compress_bound(size_t len);
+size_t he_format_compress(uint8_t *dst, const uint8_t *src, size_t len);
+// Decompressors return the bytes read from src, more than src_len if src is truncated (the rest of dst is zeroed)
+size_t he_format_decompress(uint8_t *dst, size_t len, const uint8_t *src, size_t src_len);
+
+// LZ: the window is the dictionary followed by the output
+size_t he_format_lz_decompress(uint8_t *dst, size_t len, const uint8_t *src, size_t src_len, const uint8_t *dictionary, size_t dictionarySize);
+void he_format_lz_copy(uint8_t *dst, size_t pos, size_t len, size_t offset, const uint8_t *dictionary, size_t dictionarySize);
+
+#endif /* he_format_h */
@@ -8,6 +8,8 @@
 #ifndef he_foundation_h
 #define he_foundation_h
 
+#include <stdint.h>
+
 typedef struct HERect {
     int x;
     int y;
@@ -15,6 +17,17 @@ typedef struct HERect {
     int height;
 } HERect;
 
+typedef struct HEGraphicsContext {
+    // NULL for the display frame
+    uint8_t *frame;
+    int width;
+    int height;
+    // Bytes per row, multiple of 4
+    int rowbytes;
+    HERect _clipRect;
+    HERect clipRect;
+} HEGraphicsContext;
+
 HERect he_rect_new(int x, int y, int width, int height);
 HERect he_rect_zero(void);
 
@@ -0,0 +1,275 @@
+//
+//  he_graphics.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "he_api.h"
+#include "he_prv.h"
+
+static PlaydateAPI *playdate;
+
+void he_graphics_fillRect(int x, int y, int width, int height, LCDColor color)
+{
+    HEGraphicsContext_fillRect(he_graphics_context, x, y, width, height, color);
+}
+
+void HEGraphicsContext_fillRect(HEGraphicsContext *context, int x, int y, int width, int height, LCDColor color)
+{
+    HERect rect = he_rect_intersection(context->clipRect, he_rect_new(x, y, width, height));
+    if(rect.width <= 0 || rect.height <= 0 || color == kColorClear)
+    {
+        return;
+    }
+    
+    // Pattern rows (data, mask), aligned to the screen
+    uint8_t pattern_data[8];
+    uint8_t pattern_mask[8];
+    int is_xor = (color == kColorXOR);
+    
+    if(color == kColorBlack || color == kColorWhite || is_xor)
+    {
+        memset(pattern_data, (color == kColorBlack) ? 0x00 : 0xFF, 8);
+        memset(pattern_mask, 0xFF, 8);
+    }
+    else
+    {
+        uint8_t *pattern = (uint8_t*)color;
+        memcpy(pattern_data, pattern, 8);
+        memcpy(pattern_mask, pattern + 8, 8);
+    }
+    
+    unsigned int x1 = rect.x;
+    unsigned int x2 = rect.x + rect.width;
+    unsigned int y1 = rect.y;
+    unsigned int y2 = rect.y + rect.height;
+    
+    int words = (x2 - 1) / 32 - x1 / 32 + 1;
+    
+    // Edge masks, pattern words have the same bytes and don't need bswap
+    uint32_t left_mask = 0xFFFFFFFF >> (x1 % 32);
+    uint32_t right_mask = 0xFFFFFFFF << (31 - (x2 - 1) % 32);
+    if(words == 1)
+    {
+        left_mask &= right_mask;
+    }
+    left_mask = bswap32(left_mask);
+    right_mask = bswap32(right_mask);
+    
+    uint8_t *frame_start = he_graphics_frame(context) + y1 * context->rowbytes + x1 / 32 * 4;
+    
+    for(unsigned int row = y1; row < y2; row++)
+    {
+        uint32_t data = pattern_data[row % 8] * 0x01010101U;
+        uint32_t mask = pattern_mask[row % 8] * 0x01010101U;
+        
+        uint32_t *frame_ptr = (uint32_t*)frame_start;
+        
+        if(is_xor)
+        {
+            *frame_ptr++ ^= left_mask;
+            for(int i = 1; i < (words - 1); i++)
+            {
+                *frame_ptr++ ^= 0xFFFFFFFF;
+            }
+            if(words > 1)
+            {
+                *frame_ptr ^= right_mask;
+            }
+        }
+        else
+        {
+            uint32_t edge_mask = mask & left_mask;
+            *frame_ptr = (*frame_ptr & ~edge_mask) | (data & edge_mask);
+            frame_ptr++;
+            
+            if(mask == 0xFFFFFFFF)
+            {
+                for(int i = 1; i < (words - 1); i++)
+                {
+                    *frame_ptr++ = data;
+                }
+            }
+            else
+            {
+                for(int i = 1; i < (words - 1); i++)
+                {
+                    *frame_ptr = (*frame_ptr & ~mask) | (data & mask);
+                    frame_ptr++;
+                }
+            }
+            
+            if(words > 1)
+            {
+                edge_mask = mask & right_mask;
+                *frame_ptr = (*frame_ptr & ~edge_mask) | (data & edge_mask);
+            }
+        }
+        
+        frame_start += context->rowbytes;
+    }
+    
+    he_graphics_markUpdatedRows(context, y1, y2 - 1);
+}
+
+void he_graphics_scroll(int dx, int dy)
+{
+    HEGraphicsContext_scroll(he_graphics_context, dx, dy);
+}
+
+int he_graphics_getScrollStrips(int dx, int dy, HERect strips[2])
+{
+    return HEGraphicsContext_getScrollStrips(he_graphics_context, dx, dy, strips);
+}
+
+static inline uint32_t he_graphics_rowWord(uint32_t *row, int i, int words)
+{
+    // Pixel order, words outside the row are masked out by the caller
+    return (i >= 0 && i < words) ? bswap32(row[i]) : 0;
+}
+
+static void he_graphics_scrollRow(uint32_t *dst, uint32_t *src, int words, int x1, int x2, int dx)
+{
+    // Columns x1..x2 of dst are read from column - dx of src, dst can be src
+    int first = x1 / 32;
+    int last = (x2 - 1) / 32;
+    
+    uint32_t left_mask = 0xFFFFFFFF >> (x1 % 32);
+    uint32_t right_mask = 0xFFFFFFFF << (31 - (x2 - 1) % 32);
+    
+    // Words are written after the words they are read from
+    int step = (dx > 0) ? -1 : 1;
+    int i = (dx > 0) ? last : first;
+    
+    for(int n = first; n <= last; n++, i += step)
+    {
+        int src_x = i * 32 - dx;
+        int src_i = (src_x >= 0) ? src_x / 32 : -((31 - src_x) / 32);
+        int shift = src_x - src_i * 32;
+        
+        uint32_t value = he_graphics_rowWord(src, src_i, words) << shift;
+        if(shift > 0)
+        {
+            value |= he_graphics_rowWord(src, src_i + 1, words) >> (32 - shift);
+        }
+        
+        uint32_t mask = 0xFFFFFFFF;
+        if(i == first)
+        {
+            mask &= left_mask;
+        }
+        if(i == last)
+        {
+            mask &= right_mask;
+        }
+        
+        uint32_t dst_value = bswap32(dst[i]);
+        dst[i] = bswap32((dst_value & ~mask) | (value & mask));
+    }
+}
+
+void HEGraphicsContext_scroll(HEGraphicsContext *context, int dx, int dy)
+{
+    HERect rect = context->clipRect;
+    if(rect.width <= 0 || rect.height <= 0 || (dx == 0 && dy == 0))
+    {
+        return;
+    }
+    if(abs(dx) >= rect.width || abs(dy) >= rect.height)
+    {
+        // Nothing left to move, the whole clip rect is exposed
+        return;
+    }
+    
+    // Destination columns and rows inside the clip rect
+    int x1 = rect.x + he_max(dx, 0);
+    int x2 = rect.x + rect.width + he_min(dx, 0);
+    int y1 = rect.y + he_max(dy, 0);
+    int y2 = rect.y + rect.height + he_min(dy, 0);
+    
+    uint8_t *frame = he_graphics_frame(context);
+    int words = context->rowbytes / 4;
+    
+    // Rows are written after the rows they are read from
+    int step = (dy > 0) ? -1 : 1;
+    int row = (dy > 0) ? (y2 - 1) : y1;
+    
+    for(int n = y1; n < y2; n++, row += step)
+    {
+        uint32_t *dst = (uint32_t*)(frame + row * context->rowbytes);
+        uint32_t *src = (uint32_t*)(frame + (row - dy) * context->rowbytes);
+        he_graphics_scrollRow(dst, src, words, x1, x2, dx);
+    }
+    
+    he_graphics_markUpdatedRows(context, y1, y2 - 1);
+}
+
+int HEGraphicsContext_getScrollStrips(HEGraphicsContext *context, int dx, int dy, HERect strips[2])
+{
+    HERect rect = context->clipRect;
+    if(rect.width <= 0 || rect.height <= 0)
+    {
+        return 0;
+    }
+    if(abs(dx) >= rect.width || abs(dy) >= rect.height)
+    {
+        strips[0] = rect;
+        return 1;
+    }
+    
+    int count = 0;
+    
+    // Rows
+    if(dy > 0)
+    {
+        strips[count++] = he_rect_new(rect.x, rect.y, rect.width, dy);
+    }
+    else if(dy < 0)
+    {
+        strips[count++] = he_rect_new(rect.x, rect.y + rect.height + dy, rect.width, -dy);
+    }
+    
+    // Columns, without the rows strip
+    int y = rect.y + he_max(dy, 0);
+    int height = rect.height - abs(dy);
+    
+    if(dx > 0)
+    {
+        strips[count++] = he_rect_new(rect.x, y, dx, height);
+    }
+    else if(dx < 0)
+    {
+        strips[count++] = he_rect_new(rect.x + rect.width + dx, y, -dx, height);
+    }
+    
+    return count;
+}
+
+void he_graphics_fillHLine(int x, int y, int width, LCDColor color)
+{
+    HEGraphicsContext_fillHLine(he_graphics_context, x, y, width, color);
+}
+
+void HEGraphicsContext_fillHLine(HEGraphicsContext *context, int x, int y, int width, LCDColor color)
+{
+    HEGraphicsContext_fillRect(context, x, y, width, 1, color);
+}
+
+void he_graphics_fillVLine(int x, int y, int height, LCDColor color)
+{
+    HEGraphicsContext_fillVLine(he_graphics_context, x, y, height, color);
+}
+
+void HEGraphicsContext_fillVLine(HEGraphicsContext *context, int x, int y, int height, LCDColor color)
+{
+    HEGraphicsContext_fillRect(context, x, y, 1, height, color);
+}
+
+void he_graphics_init(PlaydateAPI *pd)
+{
+    playdate = pd;
+}
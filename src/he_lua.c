@@ -0,0 +1,321 @@
+//
+//  he_lua.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <string.h>
+
+#include "he_api.h"
+
+#define HE_LUA_BITMAP_CLASS "hebitmap.bitmap"
+#define HE_LUA_TABLE_CLASS "hebitmap.table"
+
+static PlaydateAPI *playdate;
+
+static HEBitmap* he_lua_getBitmap(int pos)
+{
+    return playdate->lua->getArgObject(pos, (char*)HE_LUA_BITMAP_CLASS, NULL);
+}
+
+static HEBitmapTable* he_lua_getTable(int pos)
+{
+    return playdate->lua->getArgObject(pos, (char*)HE_LUA_TABLE_CLASS, NULL);
+}
+
+static int he_lua_pushBitmap(HEBitmap *bitmap)
+{
+    if(bitmap)
+    {
+        playdate->lua->pushObject(bitmap, (char*)HE_LUA_BITMAP_CLASS, 0);
+    }
+    else
+    {
+        playdate->lua->pushNil();
+    }
+    return 1;
+}
+
+static int he_lua_pushTable(HEBitmapTable *bitmapTable)
+{
+    if(bitmapTable)
+    {
+        playdate->lua->pushObject(bitmapTable, (char*)HE_LUA_TABLE_CLASS, 0);
+    }
+    else
+    {
+        playdate->lua->pushNil();
+    }
+    return 1;
+}
+
+static float he_lua_packedFloat(const char *buffer, size_t index)
+{
+    // Packed strings are not aligned
+    float value;
+    memcpy(&value, buffer + index * sizeof(float), sizeof(float));
+    return value;
+}
+
+//
+// Bitmap
+//
+static int he_lua_bitmap_load(lua_State *L)
+{
+    return he_lua_pushBitmap(HEBitmap_load(playdate->lua->getArgString(1)));
+}
+
+static int he_lua_bitmap_loadHEB(lua_State *L)
+{
+    return he_lua_pushBitmap(HEBitmap_loadHEB(playdate->lua->getArgString(1)));
+}
+
+static int he_lua_bitmap_gc(lua_State *L)
+{
+    HEBitmap *bitmap = he_lua_getBitmap(1);
+    if(bitmap)
+    {
+        HEBitmap_free(bitmap);
+    }
+    return 0;
+}
+
+static int he_lua_bitmap_getSize(lua_State *L)
+{
+    HEBitmap *bitmap = he_lua_getBitmap(1);
+    playdate->lua->pushInt(bitmap->width);
+    playdate->lua->pushInt(bitmap->height);
+    return 2;
+}
+
+static int he_lua_bitmap_draw(lua_State *L)
+{
+    HEBitmap *bitmap = he_lua_getBitmap(1);
+    HEBitmap_draw(bitmap, playdate->lua->getArgInt(2), playdate->lua->getArgInt(3));
+    return 0;
+}
+
+static int he_lua_bitmap_drawPacked(lua_State *L)
+{
+    // xs and ys are native floats packed in a string (see hebitmap.lua)
+    HEBitmap *bitmap = he_lua_getBitmap(1);
+    
+    size_t xs_len, ys_len;
+    const char *xs = playdate->lua->getArgBytes(2, &xs_len);
+    const char *ys = playdate->lua->getArgBytes(3, &ys_len);
+    if(!xs || !ys)
+    {
+        return 0;
+    }
+    
+    size_t count = ((xs_len < ys_len) ? xs_len : ys_len) / sizeof(float);
+    
+    for(size_t i = 0; i < count; i++)
+    {
+        HEBitmap_draw(bitmap, he_lua_packedFloat(xs, i), he_lua_packedFloat(ys, i));
+    }
+    
+    return 0;
+}
+
+static int he_lua_bitmap_colorAt(lua_State *L)
+{
+    HEBitmap *bitmap = he_lua_getBitmap(1);
+    playdate->lua->pushInt((int)HEBitmap_colorAt(bitmap, playdate->lua->getArgInt(2), playdate->lua->getArgInt(3)));
+    return 1;
+}
+
+static const lua_reg he_lua_bitmapClass[] = {
+    { "load", he_lua_bitmap_load },
+    { "loadHEB", he_lua_bitmap_loadHEB },
+    { "__gc", he_lua_bitmap_gc },
+    { "getSize", he_lua_bitmap_getSize },
+    { "draw", he_lua_bitmap_draw },
+    { "drawPacked", he_lua_bitmap_drawPacked },
+    { "colorAt", he_lua_bitmap_colorAt },
+    { NULL, NULL }
+};
+
+//
+// Bitmap table
+//
+static int he_lua_table_load(lua_State *L)
+{
+    return he_lua_pushTable(HEBitmapTable_load(playdate->lua->getArgString(1)));
+}
+
+static int he_lua_table_loadHEBT(lua_State *L)
+{
+    return he_lua_pushTable(HEBitmapTable_loadHEBT(playdate->lua->getArgString(1)));
+}
+
+static int he_lua_table_gc(lua_State *L)
+{
+    HEBitmapTable *bitmapTable = he_lua_getTable(1);
+    if(bitmapTable)
+    {
+        HEBitmapTable_free(bitmapTable);
+    }
+    return 0;
+}
+
+static int he_lua_table_getLength(lua_State *L)
+{
+    HEBitmapTable *bitmapTable = he_lua_getTable(1);
+    playdate->lua->pushInt(bitmapTable->length);
+    return 1;
+}
+
+static int he_lua_table_draw(lua_State *L)
+{
+    // Lua indexes start at 1
+    HEBitmapTable *bitmapTable = he_lua_getTable(1);
+    HEBitmap *bitmap = HEBitmap_atIndex(bitmapTable, playdate->lua->getArgInt(2) - 1);
+    if(bitmap)
+    {
+        HEBitmap_draw(bitmap, playdate->lua->getArgInt(3), playdate->lua->getArgInt(4));
+    }
+    return 0;
+}
+
+static int he_lua_table_drawPacked(lua_State *L)
+{
+    // Frame indexes can be a number (same frame) or packed floats
+    HEBitmapTable *bitmapTable = he_lua_getTable(1);
+    
+    size_t indexes_len = 0;
+    const char *indexes = NULL;
+    int index = 0;
+    
+    if(playdate->lua->getArgType(2, NULL) == kTypeString)
+    {
+        indexes = playdate->lua->getArgBytes(2, &indexes_len);
+    }
+    else
+    {
+        index = playdate->lua->getArgInt(2);
+    }
+    
+    size_t xs_len, ys_len;
+    const char *xs = playdate->lua->getArgBytes(3, &xs_len);
+    const char *ys = playdate->lua->getArgBytes(4, &ys_len);
+    if(!xs || !ys)
+    {
+        return 0;
+    }
+    
+    size_t count = ((xs_len < ys_len) ? xs_len : ys_len) / sizeof(float);
+    if(indexes && (indexes_len / sizeof(float)) < count)
+    {
+        count = indexes_len / sizeof(float);
+    }
+    
+    for(size_t i = 0; i < count; i++)
+    {
+        if(indexes)
+        {
+            index = he_lua_packedFloat(indexes, i);
+        }
+        HEBitmap *bitmap = HEBitmap_atIndex(bitmapTable, index - 1);
+        if(bitmap)
+        {
+            HEBitmap_draw(bitmap, he_lua_packedFloat(xs, i), he_lua_packedFloat(ys, i));
+        }
+    }
+    
+    return 0;
+}
+
+static int he_lua_table_drawNextFrame(lua_State *L)
+{
+    HEBitmapTable *bitmapTable = he_lua_getTable(1);
+    HEBitmapTable_drawNextFrame(bitmapTable, playdate->lua->getArgInt(2), playdate->lua->getArgInt(3));
+    return 0;
+}
+
+static int he_lua_table_setNextFrame(lua_State *L)
+{
+    HEBitmapTable *bitmapTable = he_lua_getTable(1);
+    HEBitmapTable_setNextFrame(bitmapTable, playdate->lua->getArgInt(2) - 1);
+    return 0;
+}
+
+static int he_lua_table_invalidatePlayback(lua_State *L)
+{
+    HEBitmapTable *bitmapTable = he_lua_getTable(1);
+    HEBitmapTable_invalidatePlayback(bitmapTable);
+    return 0;
+}
+
+static const lua_reg he_lua_tableClass[] = {
+    { "load", he_lua_table_load },
+    { "loadHEBT", he_lua_table_loadHEBT },
+    { "__gc", he_lua_table_gc },
+    { "getLength", he_lua_table_getLength },
+    { "draw", he_lua_table_draw },
+    { "drawPacked", he_lua_table_drawPacked },
+    { "drawNextFrame", he_lua_table_drawNextFrame },
+    { "setNextFrame", he_lua_table_setNextFrame },
+    { "invalidatePlayback", he_lua_table_invalidatePlayback },
+    { NULL, NULL }
+};
+
+//
+// Graphics
+//
+static int he_lua_graphics_setClipRect(lua_State *L)
+{
+    he_graphics_setClipRect(playdate->lua->getArgInt(1), playdate->lua->getArgInt(2), playdate->lua->getArgInt(3), playdate->lua->getArgInt(4));
+    return 0;
+}
+
+static int he_lua_graphics_clearClipRect(lua_State *L)
+{
+    he_graphics_clearClipRect();
+    return 0;
+}
+
+static int he_lua_graphics_fillRect(lua_State *L)
+{
+    // Solid colors only (playdate.graphics.kColor*)
+    he_graphics_fillRect(playdate->lua->getArgInt(1), playdate->lua->getArgInt(2), playdate->lua->getArgInt(3), playdate->lua->getArgInt(4), (LCDColor)playdate->lua->getArgInt(5));
+    return 0;
+}
+
+static const lua_reg he_lua_graphicsClass[] = {
+    { "setClipRect", he_lua_graphics_setClipRect },
+    { "clearClipRect", he_lua_graphics_clearClipRect },
+    { "fillRect", he_lua_graphics_fillRect },
+    { NULL, NULL }
+};
+
+int he_lua_register(void)
+{
+    const char *err;
+    
+    if(!playdate->lua->registerClass(HE_LUA_BITMAP_CLASS, he_lua_bitmapClass, NULL, 0, &err))
+    {
+        playdate->system->logToConsole("%s:%i: registerClass failed, %s", __FILE__, __LINE__, err);
+        return 0;
+    }
+    
+    if(!playdate->lua->registerClass(HE_LUA_TABLE_CLASS, he_lua_tableClass, NULL, 0, &err))
+    {
+        playdate->system->logToConsole("%s:%i: registerClass failed, %s", __FILE__, __LINE__, err);
+        return 0;
+    }
+    
+    if(!playdate->lua->registerClass("hebitmap.graphics", he_lua_graphicsClass, NULL, 1, &err))
+    {
+        playdate->system->logToConsole("%s:%i: registerClass failed, %s", __FILE__, __LINE__, err);
+        return 0;
+    }
+    
+    return 1;
+}
+
+void he_lua_init(PlaydateAPI *pd)
+{
+    playdate = pd;
+}
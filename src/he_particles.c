@@ -0,0 +1,278 @@
+//
+//  he_particles.c
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#include <math.h>
+
+#include "he_api.h"
+#include "he_prv.h"
+
+static PlaydateAPI *playdate;
+
+static void HEParticles_drawNarrow(HEParticles *particles, int x, int y, HEGraphicsContext *context);
+
+HEParticles* HEParticles_new(HEBitmap *bitmap, unsigned int capacity)
+{
+    HEParticles *particles = playdate->system->realloc(NULL, sizeof(HEParticles));
+    if(!particles)
+    {
+        playdate->system->logToConsole("HEParticles: cannot allocate %u particles", capacity);
+        return NULL;
+    }
+    
+    // One block for all the arrays, + 1 byte because realloc of 0 bytes frees (capacity 0)
+    float *arrays = playdate->system->realloc(NULL, sizeof(float) * 5 * capacity + 1);
+    if(!arrays)
+    {
+        playdate->system->logToConsole("HEParticles: cannot allocate %u particles", capacity);
+        playdate->system->realloc(particles, 0);
+        return NULL;
+    }
+    
+    particles->count = 0;
+    particles->x = arrays;
+    particles->y = arrays + capacity;
+    particles->vx = arrays + capacity * 2;
+    particles->vy = arrays + capacity * 3;
+    particles->life = arrays + capacity * 4;
+    
+    _HEParticles *prv = &particles->prv;
+    
+    prv->bitmap = NULL;
+    prv->rowData = NULL;
+    prv->rowMask = NULL;
+    prv->capacity = capacity;
+    prv->accelerationX = 0;
+    prv->accelerationY = 0;
+    
+    HEParticles_setBitmap(particles, bitmap);
+    
+    return particles;
+}
+
+void HEParticles_setBitmap(HEParticles *particles, HEBitmap *bitmap)
+{
+    _HEParticles *prv = &particles->prv;
+    
+    prv->bitmap = bitmap;
+    
+    if(prv->rowData)
+    {
+        playdate->system->realloc(prv->rowData, 0);
+        prv->rowData = NULL;
+        prv->rowMask = NULL;
+    }
+    
+    _HEBitmap *bitmap_prv = &bitmap->prv;
+    
+    if(bitmap_prv->bw > HE_PARTICLES_MAX_WIDTH || bitmap_prv->bh == 0)
+    {
+        // Drawn with HEBitmap_draw
+        return;
+    }
+    
+    uint32_t *rows = playdate->system->realloc(NULL, sizeof(uint32_t) * 2 * bitmap_prv->bh);
+    if(!rows)
+    {
+        return;
+    }
+    
+    // Rows are read once, the bitmap data must not change
+    for(int row = 0; row < bitmap_prv->bh; row++)
+    {
+        int i = row * bitmap_prv->rowbytes;
+        rows[row] = bitmap_prv->data ? bswap32(*(uint32_t*)(bitmap_prv->data + i)) : bitmap_prv->fill;
+        rows[bitmap_prv->bh + row] = bitmap_prv->mask ? bswap32(*(uint32_t*)(bitmap_prv->mask + i)) : 0xFFFFFFFF;
+    }
+    
+    prv->rowData = rows;
+    prv->rowMask = rows + bitmap_prv->bh;
+}
+
+void HEParticles_setAcceleration(HEParticles *particles, float ax, float ay)
+{
+    particles->prv.accelerationX = ax;
+    particles->prv.accelerationY = ay;
+}
+
+int HEParticles_add(HEParticles *particles, float x, float y, float vx, float vy, float life)
+{
+    if(particles->count >= particles->prv.capacity)
+    {
+        return 0;
+    }
+    
+    unsigned int i = particles->count++;
+    
+    particles->x[i] = x;
+    particles->y[i] = y;
+    particles->vx[i] = vx;
+    particles->vy[i] = vy;
+    particles->life[i] = (life > 0) ? life : INFINITY;
+    
+    return 1;
+}
+
+void HEParticles_remove(HEParticles *particles, unsigned int index)
+{
+    if(index >= particles->count)
+    {
+        return;
+    }
+    
+    unsigned int last = --particles->count;
+    
+    particles->x[index] = particles->x[last];
+    particles->y[index] = particles->y[last];
+    particles->vx[index] = particles->vx[last];
+    particles->vy[index] = particles->vy[last];
+    particles->life[index] = particles->life[last];
+}
+
+void HEParticles_clear(HEParticles *particles)
+{
+    particles->count = 0;
+}
+
+void HEParticles_update(HEParticles *particles, float dt)
+{
+    _HEParticles *prv = &particles->prv;
+    
+    float dvx = prv->accelerationX * dt;
+    float dvy = prv->accelerationY * dt;
+    
+    float *x = particles->x;
+    float *y = particles->y;
+    float *vx = particles->vx;
+    float *vy = particles->vy;
+    
+    // Each array is walked in order
+    for(unsigned int i = 0; i < particles->count; i++)
+    {
+        vx[i] += dvx;
+        x[i] += vx[i] * dt;
+    }
+    
+    for(unsigned int i = 0; i < particles->count; i++)
+    {
+        vy[i] += dvy;
+        y[i] += vy[i] * dt;
+    }
+    
+    // Backwards, removed particles are replaced by updated ones
+    for(unsigned int i = particles->count; i-- > 0;)
+    {
+        particles->life[i] -= dt;
+        if(particles->life[i] <= 0)
+        {
+            HEParticles_remove(particles, i);
+        }
+    }
+}
+
+void HEParticles_draw(HEParticles *particles, int x, int y)
+{
+    HEParticles_drawInContext(particles, x, y, he_graphics_context);
+}
+
+void HEParticles_drawInContext(HEParticles *particles, int x, int y, HEGraphicsContext *context)
+{
+    _HEParticles *prv = &particles->prv;
+    
+    if(particles->count == 0)
+    {
+        return;
+    }
+    
+    if(prv->rowData)
+    {
+        HEParticles_drawNarrow(particles, x, y, context);
+        return;
+    }
+    
+    for(unsigned int i = 0; i < particles->count; i++)
+    {
+        HEBitmap_drawInContext(prv->bitmap, x + (int)particles->x[i], y + (int)particles->y[i], context);
+    }
+}
+
+static void HEParticles_drawNarrow(HEParticles *particles, int x, int y, HEGraphicsContext *context)
+{
+    _HEParticles *prv = &particles->prv;
+    _HEBitmap *bitmap_prv = &prv->bitmap->prv;
+    
+    int bw = bitmap_prv->bw;
+    int bh = bitmap_prv->bh;
+    
+    x += bitmap_prv->bx;
+    y += bitmap_prv->by;
+    
+    // One clip and frame for the batch
+    HERect clipRect = context->clipRect;
+    int clip_x2 = clipRect.x + clipRect.width;
+    int clip_y2 = clipRect.y + clipRect.height;
+    
+    uint8_t *frame = he_graphics_frame(context);
+    
+    int rows_y1 = context->height;
+    int rows_y2 = 0;
+    
+    for(unsigned int i = 0; i < particles->count; i++)
+    {
+        int px = x + (int)particles->x[i];
+        int py = y + (int)particles->y[i];
+        
+        int x1 = he_max(px, clipRect.x);
+        int x2 = he_min(px + bw, clip_x2);
+        int y1 = he_max(py, clipRect.y);
+        int y2 = he_min(py + bh, clip_y2);
+        
+        if(x1 >= x2 || y1 >= y2)
+        {
+            continue;
+        }
+        
+        int base = x1 & ~31;
+        int offset = px - base;
+        uint64_t clip_mask = he_narrow_clip_mask(base, x1, x2);
+        
+        uint32_t *frame_ptr = (uint32_t*)(frame + y1 * context->rowbytes + base / 8);
+        
+        for(int row = y1 - py; row < (y2 - py); row++)
+        {
+            he_narrow_row(frame_ptr, prv->rowData[row], prv->rowMask[row], offset, clip_mask);
+            frame_ptr += context->rowbytes / 4;
+        }
+        
+        rows_y1 = he_min(rows_y1, y1);
+        rows_y2 = he_max(rows_y2, y2);
+    }
+    
+    HE_STATS_ADD(drawCalls, 1);
+    
+    if(rows_y1 < rows_y2)
+    {
+        he_graphics_markUpdatedRows(context, rows_y1, rows_y2 - 1);
+    }
+}
+
+void HEParticles_free(HEParticles *particles)
+{
+    _HEParticles *prv = &particles->prv;
+    
+    if(prv->rowData)
+    {
+        playdate->system->realloc(prv->rowData, 0);
+    }
+    
+    playdate->system->realloc(particles->x, 0);
+    playdate->system->realloc(particles, 0);
+}
+
+void he_particles_init(PlaydateAPI *pd)
+{
+    playdate = pd;
+}
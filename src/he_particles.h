@@ -0,0 +1,53 @@
+//
+//  he_particles.h
+//  HEBitmap
+//
+//  Created by Matteo D'Ignazio on 19/10/26.
+//
+
+#ifndef he_particles_h
+#define he_particles_h
+
+#include "pd_api.h"
+#include "he_bitmap.h"
+
+// Bitmaps up to 8 pixels wide use the particle kernel
+#define HE_PARTICLES_MAX_WIDTH 8
+
+typedef struct {
+    HEBitmap *bitmap;
+    // Rows of the bitmap in pixel order, empty if the bitmap is too wide
+    uint32_t *rowData;
+    uint32_t *rowMask;
+    unsigned int capacity;
+    float accelerationX;
+    float accelerationY;
+} _HEParticles;
+
+typedef struct HEParticles {
+    _HEParticles prv;
+    unsigned int count;
+    // Structure of arrays, index < count
+    float *x;
+    float *y;
+    float *vx;
+    float *vy;
+    float *life;
+} HEParticles;
+
+HEParticles* HEParticles_new(HEBitmap *bitmap, unsigned int capacity);
+void HEParticles_setBitmap(HEParticles *particles, HEBitmap *bitmap);
+void HEParticles_setAcceleration(HEParticles *particles, float ax, float ay);
+// Life in seconds (0 for no limit), returns 0 if the system is full
+int HEParticles_add(HEParticles *particles, float x, float y, float vx, float vy, float life);
+// The last particle takes the removed index
+void HEParticles_remove(HEParticles *particles, unsigned int index);
+void HEParticles_clear(HEParticles *particles);
+// Moves the particles and removes the expired ones
+void HEParticles_update(HEParticles *particles, float dt);
+// Particles are drawn at their position plus x, y
+void HEParticles_draw(HEParticles *particles, int x, int y);
+void HEParticles_drawInContext(HEParticles *particles, int x, int y, HEGraphicsContext *context);
+void HEParticles_free(HEParticles *particles);
+
+#endif /* he_particles_h */
@@ -11,6 +11,10 @@ static PlaydateAPI *playdate;
 
 HEGraphicsContext *he_graphics_context;
 
+HEStats he_stats;
+
+HEMemoryStats he_memory;
+
 //
 // Rect
 //
@@ -49,6 +53,62 @@ HERect he_rect_intersection(HERect clipRect, HERect rect)
     return rect;
 }
 
+//
+// Graphics context
+//
+uint8_t* he_graphics_frame(HEGraphicsContext *context)
+{
+    return context->frame ? context->frame : playdate->graphics->getFrame();
+}
+
+void he_graphics_markUpdatedRows(HEGraphicsContext *context, int start, int end)
+{
+    // Custom frames are not tracked by the display
+    if(!context->frame)
+    {
+        playdate->graphics->markUpdatedRows(start, end);
+    }
+}
+
+//
+// Memory
+//
+static HEMemoryCounter* he_memory_counter(HEMemoryCategory category)
+{
+    switch(category)
+    {
+        case HEMemoryPlanes:
+            return &he_memory.planes;
+        case HEMemoryRawBuffers:
+            return &he_memory.rawBuffers;
+        default:
+            return &he_memory.metadata;
+    }
+}
+
+void he_memory_alloc(HEMemoryCategory category, size_t size)
+{
+    HEMemoryCounter *counter = he_memory_counter(category);
+    
+    counter->live += size;
+    if(counter->live > counter->peak)
+    {
+        counter->peak = counter->live;
+    }
+    
+    he_memory.total.live += size;
+    if(he_memory.total.live > he_memory.total.peak)
+    {
+        he_memory.total.peak = he_memory.total.live;
+    }
+}
+
+void he_memory_free(HEMemoryCategory category, size_t size)
+{
+    he_memory_counter(category)->live -= size;
+    he_memory.total.live -= size;
+}
+
 //
 // Utils
 //
@@ -56,7 +116,7 @@ void he_bitmap_clip_bounds(HEBitmap *bitmap, int x, int y, unsigned int *x1, uns
 {
     *x1 = x;
     *offset_left = 0;
-
+    
     if(x < clipRect.x)
     {
         *x1 = clipRect.x;
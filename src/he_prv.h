@@ -11,24 +11,52 @@
 #include "he_api.h"
 #include "he_foundation.h"
 
-typedef struct {
-    HERect _clipRect;
-    HERect clipRect;
-} HEGraphicsContext;
-
 extern HEGraphicsContext *he_graphics_context;
 
-static const HERect he_gfx_screenRect = {
-    .x = 0,
-    .y = 0,
-    .width = LCD_COLUMNS,
-    .height = LCD_ROWS
-};
+uint8_t* he_graphics_frame(HEGraphicsContext *context);
+void he_graphics_markUpdatedRows(HEGraphicsContext *context, int start, int end);
+
+extern HEStats he_stats;
+
+typedef enum {
+    HEMemoryPlanes,
+    HEMemoryRawBuffers,
+    HEMemoryMetadata
+} HEMemoryCategory;
+
+extern HEMemoryStats he_memory;
+
+void he_memory_alloc(HEMemoryCategory category, size_t size);
+void he_memory_free(HEMemoryCategory category, size_t size);
+
+// Returns 0 if the asset is not in the cache
+int he_cache_release(void *asset, uint32_t hash);
+
+#if HE_STATS
+#define HE_STATS_ADD(field, value) (he_stats.field += (value))
+#else
+#define HE_STATS_ADD(field, value)
+#endif
+
+static inline HEGraphicsContext he_graphics_context_new(uint8_t *frame, int width, int height, int rowbytes)
+{
+    HERect bounds = he_rect_new(0, 0, width, height);
+    return (HEGraphicsContext){
+        .frame = frame,
+        .width = width,
+        .height = height,
+        .rowbytes = rowbytes,
+        ._clipRect = bounds,
+        .clipRect = bounds
+    };
+}
 
 HERect he_rect_intersection(HERect clipRect, HERect rect);
 
 void he_bitmap_clip_bounds(HEBitmap *bitmap, int x, int y, unsigned int *x1, unsigned int *y1, unsigned int *x2, unsigned int *y2, unsigned int *offset_left, unsigned int *offset_top, HERect clipRect);
 
+HEBitmap* _HEBitmap_fromPlanes(int width, int height, uint8_t *data, uint8_t *mask, int rowbytes);
+
 static inline int he_min(const int a, const int b)
 {
     return a < b ? a : b;
@@ -50,4 +78,41 @@ static inline uint32_t bswap32(uint32_t n)
 #endif
 }
 
+static inline uint64_t he_narrow_clip_mask(int base, int x1, int x2)
+{
+    // Columns x1..x2 relative to the first of two frame words
+    uint64_t left = 0xFFFFFFFFFFFFFFFFULL >> (x1 - base);
+    uint64_t right = ((x2 - base) >= 64) ? 0 : (0xFFFFFFFFFFFFFFFFULL >> (x2 - base));
+    return left & ~right;
+}
+
+static inline void he_narrow_row(uint32_t *frame_ptr, uint32_t data, uint32_t mask, int offset, uint64_t clip_mask)
+{
+    // Row of up to 32 pixels (pixel order) at offset from the first frame word, written to at most two words
+    uint64_t row_data = (uint64_t)data << 32;
+    uint64_t row_mask = (uint64_t)mask << 32;
+    
+    if(offset >= 0)
+    {
+        row_data >>= offset;
+        row_mask >>= offset;
+    }
+    else
+    {
+        row_data <<= -offset;
+        row_mask <<= -offset;
+    }
+    row_mask &= clip_mask;
+    
+    uint32_t mask_hi = bswap32((uint32_t)(row_mask >> 32));
+    frame_ptr[0] ^= (frame_ptr[0] ^ bswap32((uint32_t)(row_data >> 32))) & mask_hi;
+    
+    uint32_t mask_lo = (uint32_t)row_mask;
+    if(mask_lo)
+    {
+        mask_lo = bswap32(mask_lo);
+        frame_ptr[1] ^= (frame_ptr[1] ^ bswap32((uint32_t)row_data)) & mask_lo;
+    }
+}
+
 #endif /* he_prv_h */
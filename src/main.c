@@ -7,11 +7,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "pd_api.h"
 #include "he_api.h"
- 
-#define ENTITY_COUNT 300
+
+#define MAX_ENTITY_COUNT 1000
+#define BENCHMARK_WARMUP_FRAMES 10
+#define BENCHMARK_FRAMES 120
+#define BENCHMARK_SEED 42
+#define BENCHMARK_DT (1.0f / 30)
+#define BENCHMARK_TABLE_LENGTH 8
+#define BENCHMARK_BAND_HEIGHT 16
 
 typedef struct {
     float x;
@@ -20,21 +27,98 @@ typedef struct {
     int dirY;
 } Entity;
 
+typedef enum {
+    BenchmarkSpawnOnscreen,
+    BenchmarkSpawnClipped,
+    BenchmarkSpawnOffscreen
+} BenchmarkSpawn;
+
+typedef struct {
+    const char *name;
+    int entityCount;
+    int bitmapIndex;
+    BenchmarkSpawn spawn;
+    int useClipRect;
+    int useTable;
+    // 1: draw list, 2: banded draw list
+    int useDrawList;
+} BenchmarkScenario;
+
+typedef struct {
+    const char *name;
+    HEBitmap *he_bitmap;
+    LCDBitmap *lcd_bitmap;
+} BenchmarkBitmap;
+
+typedef enum {
+    BenchmarkBitmapDVD,
+    BenchmarkBitmapCatbus,
+    BenchmarkBitmapOpaque16,
+    BenchmarkBitmapOpaque64,
+    BenchmarkBitmapOpaque128,
+    BenchmarkBitmapMask16,
+    BenchmarkBitmapMask64,
+    BenchmarkBitmapMask128,
+    BenchmarkBitmapCount
+} BenchmarkBitmapIndex;
+
+static const BenchmarkScenario scenarios[] = {
+    { "dvd-100", 100, BenchmarkBitmapDVD, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "dvd-300", 300, BenchmarkBitmapDVD, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "dvd-1000", 1000, BenchmarkBitmapDVD, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "catbus-300", 300, BenchmarkBitmapCatbus, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "opaque16-1000", 1000, BenchmarkBitmapOpaque16, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "opaque64-300", 300, BenchmarkBitmapOpaque64, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "opaque128-100", 100, BenchmarkBitmapOpaque128, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "mask16-1000", 1000, BenchmarkBitmapMask16, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "mask64-300", 300, BenchmarkBitmapMask64, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "mask128-100", 100, BenchmarkBitmapMask128, BenchmarkSpawnOnscreen, 0, 0, 0 },
+    { "clip-mask64-300", 300, BenchmarkBitmapMask64, BenchmarkSpawnClipped, 1, 0, 0 },
+    { "clip-opaque64-300", 300, BenchmarkBitmapOpaque64, BenchmarkSpawnClipped, 1, 0, 0 },
+    { "offscreen-dvd-1000", 1000, BenchmarkBitmapDVD, BenchmarkSpawnOffscreen, 0, 0, 0 },
+    { "table-mask64-300", 300, BenchmarkBitmapMask64, BenchmarkSpawnOnscreen, 0, 1, 0 },
+    { "drawlist-opaque128-100", 100, BenchmarkBitmapOpaque128, BenchmarkSpawnOnscreen, 0, 0, 1 },
+    { "drawlist-mask64-300", 300, BenchmarkBitmapMask64, BenchmarkSpawnOnscreen, 0, 0, 1 },
+    { "banded-mask16-1000", 1000, BenchmarkBitmapMask16, BenchmarkSpawnOnscreen, 0, 0, 2 },
+    { "banded-dvd-1000", 1000, BenchmarkBitmapDVD, BenchmarkSpawnOnscreen, 0, 0, 2 },
+};
+
+static const int scenarios_count = sizeof(scenarios) / sizeof(scenarios[0]);
+
+static const HERect benchmark_clipRect = {
+    .x = 40,
+    .y = 40,
+    .width = LCD_COLUMNS - 80,
+    .height = LCD_ROWS - 80
+};
+
 static PlaydateAPI *playdate;
 
-static HEBitmap *he_bitmap;
-static LCDBitmap *lcd_bitmap;
+static BenchmarkBitmap bitmaps[BenchmarkBitmapCount];
+static HEBitmapTable *he_bitmapTable;
+static HEDrawList *he_drawList;
+static LCDBitmapTable *lcd_bitmapTable;
+
+static Entity entities[MAX_ENTITY_COUNT];
+static float frame_times[BENCHMARK_FRAMES];
+
+static int scenario_index = 0;
+static int scenario_frame = 0;
 static int use_sdk = 0;
+static int benchmark_done = 0;
+
 static int debug_mode = 0;
 static int debug_clip = 0;
-static Entity* entities[ENTITY_COUNT];
-static float velocity = 20;
 static float x_delta = 0;
 static float y_delta = 0;
 static PDMenuItem *debugMenuItem;
 
+#ifndef LUA_EXAMPLE
 static int update(void* userdata);
 static void debugMenuCallback(void *userdata);
+#endif
+static void benchmark_init(void);
+static void benchmark_start_scenario(void);
 
 #ifdef _WINDLL
 __declspec(dllexport)
@@ -50,106 +134,338 @@ int eventHandler(PlaydateAPI* pd, PDSystemEvent event, uint32_t arg)
         playdate->display->setRefreshRate(0);
         
         he_library_init(pd);
-        
-        lcd_bitmap = playdate->graphics->loadBitmap("dvd", NULL);
-        he_bitmap = HEBitmap_load("dvd");
-        
-        for(int i = 0; i < ENTITY_COUNT; i++)
-        {
-            Entity *entity = playdate->system->realloc(NULL, sizeof(Entity));
-            
-            entity->x = rand() % (LCD_COLUMNS - he_bitmap->width + 1);
-            entity->y = rand() % (LCD_ROWS - he_bitmap->height + 1);
-            
-            entity->dirX = rand() % 2;
-            entity->dirY = rand() % 2;
-            
-            entities[i] = entity;
-        }
+
+#ifndef LUA_EXAMPLE
+        benchmark_init();
+        benchmark_start_scenario();
         
         debugMenuItem = playdate->system->addCheckmarkMenuItem("Debug", debug_mode, debugMenuCallback, NULL);
         
         // Note: If you set an update callback in the kEventInit handler, the system assumes the game is pure C and doesn't run any Lua code in the game
         pd->system->setUpdateCallback(update, pd);
+#endif
+    }
+#ifdef LUA_EXAMPLE
+    else if(event == kEventInitLua)
+    {
+        // Lua game: Source/main.lua
+        he_lua_register();
     }
+#endif
     
     return 0;
 }
 
-#ifndef LUA_EXAMPLE
-static int update(void *userdata)
+//
+// Benchmark
+//
+static BenchmarkBitmap benchmark_bitmap_load(const char *name)
 {
-    float dt = playdate->system->getElapsedTime();
-    playdate->system->resetElapsedTime();
+    return (BenchmarkBitmap){
+        .name = name,
+        .he_bitmap = HEBitmap_load(name),
+        .lcd_bitmap = playdate->graphics->loadBitmap(name, NULL)
+    };
+}
+
+static BenchmarkBitmap benchmark_bitmap_new(const char *name, int size, int masked)
+{
+    LCDBitmap *lcd_bitmap = playdate->graphics->newBitmap(size, size, masked ? kColorClear : kColorWhite);
     
-    PDButtons pressed;
-    PDButtons pushed;
-    playdate->system->getButtonState(&pressed, &pushed, NULL);
+    playdate->graphics->pushContext(lcd_bitmap);
+    if(masked)
+    {
+        playdate->graphics->fillEllipse(0, 0, size, size, 0, 0, kColorBlack);
+        playdate->graphics->fillEllipse(size / 4, size / 4, size / 2, size / 2, 0, 0, kColorWhite);
+    }
+    else
+    {
+        for(int i = 0; i < size; i += 4)
+        {
+            playdate->graphics->drawLine(i, 0, size - 1 - i, size - 1, 1, kColorBlack);
+        }
+    }
+    playdate->graphics->popContext();
+    
+    return (BenchmarkBitmap){
+        .name = name,
+        .he_bitmap = HEBitmap_fromLCDBitmap(lcd_bitmap),
+        .lcd_bitmap = lcd_bitmap
+    };
+}
+
+static void benchmark_init(void)
+{
+    bitmaps[BenchmarkBitmapDVD] = benchmark_bitmap_load("dvd");
+    bitmaps[BenchmarkBitmapCatbus] = benchmark_bitmap_load("catbus");
+    bitmaps[BenchmarkBitmapOpaque16] = benchmark_bitmap_new("opaque16", 16, 0);
+    bitmaps[BenchmarkBitmapOpaque64] = benchmark_bitmap_new("opaque64", 64, 0);
+    bitmaps[BenchmarkBitmapOpaque128] = benchmark_bitmap_new("opaque128", 128, 0);
+    bitmaps[BenchmarkBitmapMask16] = benchmark_bitmap_new("mask16", 16, 1);
+    bitmaps[BenchmarkBitmapMask64] = benchmark_bitmap_new("mask64", 64, 1);
+    bitmaps[BenchmarkBitmapMask128] = benchmark_bitmap_new("mask128", 128, 1);
     
-    if(pushed & kButtonA)
+    // Table animation: a growing circle
+    int size = 64;
+    lcd_bitmapTable = playdate->graphics->newBitmapTable(BENCHMARK_TABLE_LENGTH, size, size);
+    for(int i = 0; i < BENCHMARK_TABLE_LENGTH; i++)
     {
-        use_sdk = !use_sdk;
+        LCDBitmap *lcd_bitmap = playdate->graphics->getTableBitmap(lcd_bitmapTable, i);
+        playdate->graphics->clearBitmap(lcd_bitmap, kColorClear);
+        
+        int circle_size = size * (i + 1) / BENCHMARK_TABLE_LENGTH;
+        int circle_offset = (size - circle_size) / 2;
+        
+        playdate->graphics->pushContext(lcd_bitmap);
+        playdate->graphics->fillEllipse(circle_offset, circle_offset, circle_size, circle_size, 0, 0, kColorBlack);
+        playdate->graphics->popContext();
     }
+    he_bitmapTable = HEBitmapTable_fromLCDBitmapTable(lcd_bitmapTable);
     
-    playdate->graphics->clear(kColorWhite);
+    he_drawList = HEDrawList_new();
     
-    if(!debug_mode)
+    playdate->system->logToConsole("scenario,path,entities,bitmap,width,height,frames,min_ms,median_ms,p99_ms");
+}
+
+static void benchmark_start_scenario(void)
+{
+    const BenchmarkScenario *scenario = &scenarios[scenario_index];
+    HEBitmap *he_bitmap = bitmaps[scenario->bitmapIndex].he_bitmap;
+    
+    scenario_frame = 0;
+    
+    // Both paths draw the same entities
+    srand(BENCHMARK_SEED + scenario_index);
+    
+    for(int i = 0; i < scenario->entityCount; i++)
     {
-        float translation = velocity * dt;
-        
-        int max_x = LCD_COLUMNS - 1 - he_bitmap->width;
-        int max_y = LCD_ROWS - 1 - he_bitmap->height;
-        
-        for(int i = 0; i < ENTITY_COUNT; i++)
-        {
-            Entity *entity = entities[i];
-            
-            entity->x += (entity->dirX ? translation : -translation);
-            entity->y += (entity->dirY ? translation : -translation);
-            
-            int x1 = roundf(entity->x);
-            int y1 = roundf(entity->y);
-            
-            int x2 = x1 + he_bitmap->width;
-            int y2 = y1 + he_bitmap->height;
-            
-            if(x1 < 0)
-            {
-                entity->x = 0;
-                entity->dirX = !entity->dirX;
-            }
-            else if(x2 >= LCD_COLUMNS)
-            {
-                entity->x = max_x;
-                entity->dirX = !entity->dirX;
-            }
-            
-            if(y1 < 0)
-            {
-                entity->y = 0;
-                entity->dirY = !entity->dirY;
-            }
-            else if(y2 >= LCD_ROWS)
-            {
-                entity->y = max_y;
-                entity->dirY = !entity->dirY;
-            }
-            
-            int x = roundf(entity->x);
-            int y = roundf(entity->y);
-            
+        Entity *entity = &entities[i];
+        
+        switch(scenario->spawn)
+        {
+            case BenchmarkSpawnOnscreen:
+                entity->x = rand() % (LCD_COLUMNS - he_bitmap->width + 1);
+                entity->y = rand() % (LCD_ROWS - he_bitmap->height + 1);
+                break;
+            case BenchmarkSpawnClipped:
+                // Entities straddle the clip rect edges
+                entity->x = benchmark_clipRect.x - he_bitmap->width / 2 + (rand() % 2) * benchmark_clipRect.width + rand() % 9 - 4;
+                entity->y = rand() % (LCD_ROWS - he_bitmap->height + 1);
+                break;
+            case BenchmarkSpawnOffscreen:
+                entity->x = LCD_COLUMNS + rand() % LCD_COLUMNS;
+                entity->y = -he_bitmap->height - rand() % LCD_ROWS;
+                break;
+        }
+        
+        entity->dirX = rand() % 2;
+        entity->dirY = rand() % 2;
+    }
+}
+
+static int compare_float(const void *a, const void *b)
+{
+    float fa = *(const float*)a;
+    float fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+static void benchmark_log_scenario(void)
+{
+    const BenchmarkScenario *scenario = &scenarios[scenario_index];
+    BenchmarkBitmap *bitmap = &bitmaps[scenario->bitmapIndex];
+    
+    qsort(frame_times, BENCHMARK_FRAMES, sizeof(float), compare_float);
+    
+    float min_ms = frame_times[0] * 1000;
+    float median_ms = frame_times[BENCHMARK_FRAMES / 2] * 1000;
+    float p99_ms = frame_times[(BENCHMARK_FRAMES * 99) / 100] * 1000;
+    
+    // Milliseconds with three decimals
+    playdate->system->logToConsole("%s,%s,%d,%s,%d,%d,%d,%d.%03d,%d.%03d,%d.%03d",
+                                   scenario->name,
+                                   use_sdk ? "sdk" : "he",
+                                   scenario->entityCount,
+                                   bitmap->name,
+                                   bitmap->he_bitmap->width,
+                                   bitmap->he_bitmap->height,
+                                   BENCHMARK_FRAMES,
+                                   (int)min_ms, (int)(min_ms * 1000) % 1000,
+                                   (int)median_ms, (int)(median_ms * 1000) % 1000,
+                                   (int)p99_ms, (int)(p99_ms * 1000) % 1000);
+}
+
+static void benchmark_move_entity(Entity *entity, int width, int height, float translation)
+{
+    entity->x += (entity->dirX ? translation : -translation);
+    entity->y += (entity->dirY ? translation : -translation);
+    
+    int x1 = roundf(entity->x);
+    int y1 = roundf(entity->y);
+    
+    int x2 = x1 + width;
+    int y2 = y1 + height;
+    
+    if(x1 < 0)
+    {
+        entity->x = 0;
+        entity->dirX = !entity->dirX;
+    }
+    else if(x2 >= LCD_COLUMNS)
+    {
+        entity->x = LCD_COLUMNS - 1 - width;
+        entity->dirX = !entity->dirX;
+    }
+    
+    if(y1 < 0)
+    {
+        entity->y = 0;
+        entity->dirY = !entity->dirY;
+    }
+    else if(y2 >= LCD_ROWS)
+    {
+        entity->y = LCD_ROWS - 1 - height;
+        entity->dirY = !entity->dirY;
+    }
+}
+
+static void benchmark_update(void)
+{
+    const BenchmarkScenario *scenario = &scenarios[scenario_index];
+    BenchmarkBitmap *bitmap = &bitmaps[scenario->bitmapIndex];
+    
+    // Entities move with a fixed time step so that each run is reproducible
+    float translation = 20 * BENCHMARK_DT;
+    
+    if(scenario->useClipRect)
+    {
+        playdate->graphics->setClipRect(benchmark_clipRect.x, benchmark_clipRect.y, benchmark_clipRect.width, benchmark_clipRect.height);
+        he_graphics_setClipRect(benchmark_clipRect.x, benchmark_clipRect.y, benchmark_clipRect.width, benchmark_clipRect.height);
+    }
+    
+    float start_time = playdate->system->getElapsedTime();
+    
+    for(int i = 0; i < scenario->entityCount; i++)
+    {
+        Entity *entity = &entities[i];
+        
+        if(scenario->spawn == BenchmarkSpawnOnscreen)
+        {
+            benchmark_move_entity(entity, bitmap->he_bitmap->width, bitmap->he_bitmap->height, translation);
+        }
+        
+        int x = roundf(entity->x);
+        int y = roundf(entity->y);
+        
+        if(scenario->useTable)
+        {
+            int index = (scenario_frame + i) % BENCHMARK_TABLE_LENGTH;
             if(use_sdk)
             {
-                playdate->graphics->drawBitmap(lcd_bitmap, x, y, kBitmapUnflipped);
+                playdate->graphics->drawBitmap(playdate->graphics->getTableBitmap(lcd_bitmapTable, index), x, y, kBitmapUnflipped);
             }
             else
             {
-                HEBitmap_draw(he_bitmap, x, y);
+                HEBitmap_draw(HEBitmap_atIndex(he_bitmapTable, index), x, y);
             }
         }
+        else if(use_sdk)
+        {
+            playdate->graphics->drawBitmap(bitmap->lcd_bitmap, x, y, kBitmapUnflipped);
+        }
+        else if(scenario->useDrawList)
+        {
+            HEDrawList_addBitmap(he_drawList, bitmap->he_bitmap, x, y);
+        }
+        else
+        {
+            HEBitmap_draw(bitmap->he_bitmap, x, y);
+        }
+    }
+    
+    if(scenario->useDrawList && !use_sdk)
+    {
+        HEDrawList_setBandHeight(he_drawList, (scenario->useDrawList == 2) ? BENCHMARK_BAND_HEIGHT : 0);
+        HEDrawList_flush(he_drawList);
+    }
+    
+    float frame_time = playdate->system->getElapsedTime() - start_time;
+    
+    playdate->graphics->clearClipRect();
+    he_graphics_clearClipRect();
+    
+    if(scenario_frame >= BENCHMARK_WARMUP_FRAMES)
+    {
+        frame_times[scenario_frame - BENCHMARK_WARMUP_FRAMES] = frame_time;
+    }
+    
+    scenario_frame++;
+    
+    if(scenario_frame >= (BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES))
+    {
+        benchmark_log_scenario();
+        
+        // Each scenario runs on the HE path first, then on the SDK path
+        if(!use_sdk)
+        {
+            use_sdk = 1;
+        }
+        else
+        {
+            use_sdk = 0;
+            scenario_index++;
+        }
+        
+        if(scenario_index >= scenarios_count)
+        {
+            scenario_index = 0;
+            benchmark_done = 1;
+            playdate->system->logToConsole("Benchmark done");
+        }
+        
+        benchmark_start_scenario();
+    }
+}
+
+#ifndef LUA_EXAMPLE
+static int update(void *userdata)
+{
+    float dt = playdate->system->getElapsedTime();
+    playdate->system->resetElapsedTime();
+    
+    PDButtons pressed;
+    PDButtons pushed;
+    playdate->system->getButtonState(&pressed, &pushed, NULL);
+    
+    playdate->graphics->clear(kColorWhite);
+    
+    if(!debug_mode)
+    {
+        if(!benchmark_done)
+        {
+            benchmark_update();
+        }
+        else if(pushed & kButtonA)
+        {
+            // Run the benchmark again
+            benchmark_done = 0;
+            benchmark_start_scenario();
+        }
+        
+        const char *status = benchmark_done ? "Done, press A to run again" : scenarios[scenario_index].name;
+        playdate->graphics->fillRect(0, LCD_ROWS - 20, LCD_COLUMNS, 20, kColorWhite);
+        playdate->graphics->drawText(status, strlen(status), kASCIIEncoding, 4, LCD_ROWS - 18);
     }
     else
     {
+        if(pushed & kButtonA)
+        {
+            use_sdk = !use_sdk;
+        }
+        
+        HEBitmap *he_bitmap = bitmaps[BenchmarkBitmapDVD].he_bitmap;
+        LCDBitmap *lcd_bitmap = bitmaps[BenchmarkBitmapDVD].lcd_bitmap;
+        
         int delta = roundf(100 * dt);
         
         if(pressed & kButtonLeft)
@@ -210,5 +526,9 @@ static int update(void *userdata)
 static void debugMenuCallback(void *userdata)
 {
     debug_mode = playdate->system->getMenuItemValue(debugMenuItem);
+    
+    // Restart the current scenario when leaving debug mode
+    use_sdk = 0;
+    benchmark_start_scenario();
 }
 #endif